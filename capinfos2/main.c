@@ -44,6 +44,8 @@ typedef unsigned int 		bool;
 #define true		1
 #define false		0
 
+#include "include/fmadio_time.h"
+
 // ethernet header
 typedef struct fEther_t
 {
@@ -121,13 +123,6 @@ typedef struct PCAPPacket_t
 } __attribute__((packed)) PCAPPacket_t;
 
 
-static inline volatile u64 rdtsc(void)
-{
-	u32 hi, lo;
-	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi) );
-	return (((u64)hi)<<32ULL) | (u64)lo;
-}
-
 static inline double inverse(const double a)
 {
 	if (a == 0) return 0;
@@ -197,9 +192,6 @@ static u64		s_TSLast				= 0;			// last TS seen
 
 static bool		s_SingleDump			= false;		// dump contents of the packet as a single line  
 
-
-double TSC2Nano = 0;
-
 //-------------------------------------------------------------------------------------------------
 
 static u64		s_LastTS		= 0;
@@ -21,6 +21,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
 #include <sys/socket.h>
 #include <linux/if_packet.h>
 #include <net/ethernet.h>
@@ -28,6 +30,7 @@
 #include <netinet/in.h>
 
 #include "include/fmadio_packet.h"
+#include "include/fmadio_bpf.h"
 
 #define CLOSE_SOCK \
 	if (close(Socket) < 0) \
@@ -50,6 +53,7 @@ enum {
 	EXIT_MMAP,
 	EXIT_POLL,
 	EXIT_SOCKETCLOSE,
+	EXIT_BPF,
 };
 
 typedef struct {
@@ -63,6 +67,7 @@ typedef struct {
 	u64 SentPkt, SentByte;
 	u64 FailedPkt, FailedByte;
 	u64 TruncatedPkt, TruncatedByte;
+	u64 FilteredPkt, FilteredByte;
 } Stats_t;
 
 volatile sig_atomic_t s_Exit = false;
@@ -86,8 +91,11 @@ static void PrintHelp(void)
 			"Options:\n"
 			"		-i <path to FMAD ring file> (required)\n"
 			"		-e <interface name> (required)\n"
-			"		--cpu <integer> : pin the process to the specified CPU core\n"
-			"		--no-sleep : use `ndelay` for a high-frequency loop\n");
+			"		--cpu <integer|auto> : pin the process to the specified CPU core, auto picks one local to the rings NUMA node\n"
+			"		--no-sleep : use `ndelay` for a high-frequency loop\n"
+			"		--cursor <name> : attach as a named reader, every reader sees all packets\n"
+			"		--resume : continue from where the reader left off instead of the write pointer\n"
+			"		--bpf <filter> : only emit packets matching a tcpdump expression (built WITH_PCAP) or tcpdump -ddd output, @<file> reads it from a file\n");
 }
 
 static void PrintStats(Stats_t* Stats)
@@ -102,6 +110,8 @@ static void PrintStats(Stats_t* Stats)
 			Stats->FailedPkt, Stats->FailedByte);
 	fprintf(stderr, "Truncated: %lli packets (%lliB lost in total)\n",
 			Stats->TruncatedPkt, Stats->TruncatedByte);
+	fprintf(stderr, "Filtered: %lli packets (%lliB)\n",
+			Stats->FilteredPkt, Stats->FilteredByte);
 }
 
 int main(int argc, char* argv[])
@@ -109,7 +119,10 @@ int main(int argc, char* argv[])
 	int CPU = -1;
 	u8* RingPath = NULL;
 	u8* IFace = NULL;
+	u8* CursorName = NULL;
 	bool NoSleep = false;
+	bool IsResume = false;
+	fFMADBPF_t* BPF = NULL;
 
 	for (int i = 1; i < argc; ++i)
 	{
@@ -148,14 +161,46 @@ int main(int argc, char* argv[])
 				return EXIT_MISSINGARG;
 			}
 
-			CPU = atoi(argv[i + 1]);
-			fprintf(stderr, "Will pin thread to CPU %i.\n", CPU);
+			CPU = (strcmp(argv[i + 1], "auto") == 0) ? FMADRING_CPU_AUTO : atoi(argv[i + 1]);
+			fprintf(stderr, "Will pin thread to CPU %s.\n", argv[i + 1]);
 			i += 1;
 		}
 		else if (strcmp(argv[i], "--no-sleep") == 0)
 		{
 			NoSleep = true;
 		}
+		else if (strcmp(argv[i], "--cursor") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr,
+						"argument `--cursor` expects a following string argument.\n");
+
+				return EXIT_MISSINGARG;
+			}
+
+			CursorName = argv[i + 1];
+			i += 1;
+		}
+		else if (strcmp(argv[i], "--resume") == 0)
+		{
+			IsResume = true;
+		}
+		else if (strcmp(argv[i], "--bpf") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr,
+						"argument `--bpf` expects a following filter argument.\n");
+
+				return EXIT_MISSINGARG;
+			}
+
+			BPF = FMADBPF_Compile(argv[i + 1]);
+			if (BPF == NULL)
+				return EXIT_BPF;
+			i += 1;
+		}
 		else if (strcmp(argv[i], "--help") == 0)
 		{
 			PrintHelp();
@@ -174,14 +219,6 @@ int main(int argc, char* argv[])
 	signal(SIGHUP,  SignalHandler);
 	signal(SIGPIPE, SignalHandler);
 
-	if (CPU != -1)
-	{
-		cpu_set_t mask;
-		CPU_ZERO(&mask);
-		CPU_SET(CPU, &mask);
-		sched_setaffinity(0, sizeof(mask), &mask);
-	}
-
 	if (RingPath == NULL)
 	{
 		fprintf(stderr, "Specify ring buffer with `-i <path to ring file>`\n");
@@ -196,13 +233,40 @@ int main(int argc, char* argv[])
 
 	int RingFD = -1;
 	fFMADRingHeader_t* Ring = NULL;
+	fFMADRingCursor_t* Cursor = NULL;
 
-	if (FMADPacket_OpenRx(&RingFD, &Ring, true, RingPath) < 0)
+	int Result = 0;
+	if (IsResume)
+	{
+		u64 BacklogPkt = 0;
+		u64 LostPkt = 0;
+		Result = FMADPacket_OpenRxResume(&RingFD, &Ring, &Cursor, RingPath, CursorName, &BacklogPkt, &LostPkt);
+		if (Result == 0)
+		{
+			fprintf(stderr, "Resumed with %lli packets backlogged, %lli packets lost.\n", BacklogPkt, LostPkt);
+		}
+	}
+	else
+	{
+		Result = FMADPacket_OpenRxCursor(&RingFD, &Ring, &Cursor, RingPath, CursorName);
+	}
+
+	if (Result < 0)
 	{
 		fprintf(stderr, "Failed to open FMAD ring: `%s`\n", RingPath);	
 		return EXIT_FMADRING;
 	}
 
+	// pin local to the ring memory
+	CPU = FMADPacket_NUMACPU(Ring, CPU);
+	if (CPU != -1)
+	{
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+		CPU_SET(CPU, &mask);
+		sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
 	int Socket = socket(PF_PACKET, SOCK_RAW, 0);
 
 	if (Socket < 0)
@@ -321,38 +385,34 @@ int main(int argc, char* argv[])
 	ssize_t RingOffs = 0;
 	u64 WaitingPkt = 0, WaitingByte = 0;
 
-	u32 PktBufferMax = 128 * 1024;
-	u8* PktBuffer = malloc(PktBufferMax);
-	memset(PktBuffer, 0, PktBufferMax);
-
 	Stats_t Stats = {0};
 	fprintf(stderr, "Ring receive loop starting...\n");
 
 	while (!s_Exit)
 	{		
-		u64 TS;
-		PCAPPacket_t* Pkt	= (PCAPPacket_t*)PktBuffer;
+		const fFMADRingPacket_t* Pkt = NULL;
 
-		// fetch packet from ring without blocking
-		int Result = FMADPacket_RecvV1(Ring,
-									   false,
-									   &TS,
-									   &Pkt->LengthWire, &Pkt->LengthCapture,
-									   NULL, NULL, Pkt + 1);
+		// fetch packet from ring without blocking, payload is read in place
+		int Result = FMADPacket_RecvPeekCursor(Ring, Cursor, false, &Pkt);
 
 		if (Result > 0)
 		{
 			Stats.ReceivedPkt += 1;
 			Stats.ReceivedByte += Result;
 
-			// sanitize it
-			assert(Pkt->LengthCapture > 0);	
-			assert(Pkt->LengthCapture < (16 * 1024));
-
-			Pkt->Sec = TS / (u64)1e9;
-			Pkt->NSec = TS % (u64)1e9;
+			// filter on the ring slot
+			if ((BPF != NULL) && !FMADBPF_Packet(BPF, Pkt))
+			{
+				Stats.FilteredPkt += 1;
+				Stats.FilteredByte += Result;
+				FMADPacket_RecvReleaseCursor(Ring, Cursor, Pkt);
+				continue;
+			}
 
-			size_t Len = sizeof(PCAPPacket_t) + Pkt->LengthCapture;
+			// frame bytes to send, the pcap header is not part of the frame. read once, on an
+			// overwrite ring the slot may be mid re-write, the release check drops it
+			size_t Len = Pkt->LengthCapture;
+			if (Len > FMADRING_ENTRYSIZE) Len = FMADRING_ENTRYSIZE;
 
 			if (Len > MTU)
 			{
@@ -379,26 +439,33 @@ int main(int argc, char* argv[])
 					if (errno != EINTR)
 					{
 						fprintf(stderr, "TX ring poll failed: %s\n", strerror(errno));
+						FMADPacket_RecvReleaseCursor(Ring, Cursor, Pkt);
 						PrintStats(&Stats);
 						CLOSE_SOCK
 						return EXIT_POLL;
 					}
 
 					fprintf(stderr, "TX ring polling interrupted.\n");
+					FMADPacket_RecvReleaseCursor(Ring, Cursor, Pkt);
 					PrintStats(&Stats);
 					CLOSE_SOCK
 					return EXIT_SUCCESS;
 				}
 			}
 
-			// where to write data to
+			// copy straight from the ring slot into the tpacket frame
 			u8* Dest = (u8*)Header + sizeof(struct tpacket2_hdr);
-			u8* Src  = (u8*)(Pkt + 1);
-			memcpy(Dest, Src, Len);
+			memcpy(Dest, Pkt->Payload, Len);
+
+			u64 TS = Pkt->TS;
+
+			// ring slot no longer needed, a slot overwritten during the copy is
+			// counted as lost on the cursor and the frame is not sent 
+			if (!FMADPacket_RecvReleaseCursor(Ring, Cursor, Pkt)) continue;
 
 			// tell tpacket about it 
-			Header->tp_sec		= Pkt->Sec;
-			Header->tp_nsec 	= Pkt->NSec;
+			Header->tp_sec		= TS / (u64)1e9;
+			Header->tp_nsec 	= TS % (u64)1e9;
 			Header->tp_len 		= Len;
 			Header->tp_status	= TP_STATUS_SEND_REQUEST;
 
@@ -460,7 +527,7 @@ int main(int argc, char* argv[])
 			}
 			else
 			{
-				usleep(0);
+				FMADPacket_RecvSleep(Ring, Cursor, 100e6);
 			}
 		}
 	}
@@ -481,6 +548,9 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	// producer no longer waits for this reader
+	FMADPacket_CursorDetach(Ring, Cursor);
+
 	fflush(stdout);
 	PrintStats(&Stats);
 	CLOSE_SOCK
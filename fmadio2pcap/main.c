@@ -18,12 +18,18 @@
 #include <errno.h>
 #include <signal.h>
 #include <sched.h> 
+#include <pthread.h>
+#include <time.h>
 
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 
 #include "include/fmadio_packet.h"
+#include "include/fmadio_bpf.h"
 
 //------------------------------------------------------------------------------
 
@@ -31,7 +37,443 @@ static bool					s_IsRING	= false;			// shm ring format
 static u8*					s_RINGPath	= NULL;				// path to shm file
 static int					s_RINGfd;						// ring file handle
 static fFMADRingHeader_t*	s_RING		= NULL;  			// mapping
+static u8*					s_CursorName= NULL;				// named reader, NULL for the default reader
+static fFMADRingCursor_t*	s_Cursor	= NULL;				// read position
 static bool					s_NoSleep	= false;			// by default dont use the busy/poll
+static bool					s_IsResume	= false;			// continue from the readers last position
+
+static u8*					s_OutPath	= NULL;				// output file or rotated file prefix, NULL for stdout
+static bool					s_IsDirect	= false;			// O_DIRECT output file
+static u64					s_BlockSize	= 8*1024*1024;		// bytes per output write
+static u64					s_QueueSize	= 256*1024*1024;	// bytes queued between the ring reader and file writer
+static u64					s_RotateByte= 0;				// new file past this size, 0 never
+static u64					s_RotateNS	= 0;				// new file each interval of packet time, 0 never
+static u8*					s_OnClose	= NULL;				// command run on each finished file
+static fFMADBPF_t*			s_BPF		= NULL;				// packet filter, NULL for all packets
+
+//------------------------------------------------------------------------------
+// block writer. the reader thread copies pcap records into a queue of large aligned 
+// blocks, a writer thread hands them to write() so draining the ring only waits on 
+// the disk once the whole queue is full. records span blocks, only the last block 
+// of a file is short. with rotation each file starts on a new block which carries 
+// the file name, the writer thread closes the previous file and runs the on-close 
+// hook on it
+
+#define WRITER_ALIGN				4096					// O_DIRECT buffer/length alignment
+#define WRITER_FLUSH_NS				1e9						// idle time before a partial block goes out 
+#define WRITER_PATH_MAX				256
+
+typedef struct WriterConfig_t
+{
+	u8*					Path;						// output file, or file name prefix when rotating. NULL for stdout
+	bool				IsDirect;					// open output files with O_DIRECT
+	u64					BlockSize;					// bytes per write
+	u64					QueueSize;					// bytes of blocks between reader and writer, at least 2 blocks
+
+	u64					RotateByte;					// start a new file past this size, 0 never
+	u64					RotateNS;					// start a new file each interval of packet time, 0 never
+	u8*					OnClose;					// shell command run with each finished file as $1, NULL none
+
+} WriterConfig_t;
+
+typedef struct WriterBlock_t
+{
+	u8*					Buffer;						// aligned block buffer
+	u64					Length;						// bytes to write once queued
+	u8					Path[WRITER_PATH_MAX];		// file the block starts, empty continues the current file
+
+} WriterBlock_t;
+
+typedef struct Writer_t
+{
+	WriterConfig_t		Config;
+
+	// reader side
+	u64					BlockSize;					// bytes per block
+	u32					BlockCnt;					// blocks in the queue
+	WriterBlock_t*		Block;
+
+	volatile u64		BlockPut;					// blocks queued by the reader
+	volatile u64		BlockGet;					// blocks written
+	u64					BlockPos;					// fill position of block BlockPut
+	u64					BlockTSC;					// first byte went into the block
+
+	bool				IsFile;						// a file has been started
+	u64					FileByte;					// bytes in the current file
+	u64					FileTS;						// first packet of the current file
+
+	u64					RecordByte;					// size of the record waiting for Writer_Commit
+	bool				IsRecordStaged;				// record is in Record instead of the block
+	u8					Record[sizeof(PCAPPacket_t) + FMADRING_ENTRYSIZE];	// record crossing the end of the block
+
+	// writer side
+	int					fd;							// current output file, -1 none
+	bool				IsDirectFile;				// fd has O_DIRECT set
+	u8					FilePath[WRITER_PATH_MAX];	// current output file
+
+	pthread_t			Thread;
+	pthread_mutex_t		Lock;
+	pthread_cond_t		Cond;
+	volatile bool		IsExit;						// no more blocks, writer exits once drained
+	volatile bool		IsError;					// write failed, rest is discarded
+
+	u64					WriteByte;					// bytes written
+	u64					WriteTSC;					// cycles inside write()
+	u64					FileCnt;					// files closed
+	u64					StallCnt;					// reader waited for a free block
+	u64					StallTSC;					// cycles the reader waited
+	u64					QueueMax;					// most blocks queued at once
+	u64					StartTSC;
+
+} Writer_t;
+
+//------------------------------------------------------------------------------
+// write all of Buffer, restarting on partial writes
+static int Writer_WriteAll(Writer_t* W, const u8* Buffer, u64 Length)
+{
+	u64 Pos = 0;
+	while (Pos < Length)
+	{
+		ssize_t ret = write(W->fd, Buffer + Pos, Length - Pos);
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+
+			fprintf(stderr, "write failed [%s] errno:%i %s\n", W->FilePath, errno, strerror(errno));
+			return -1;
+		}
+		Pos += ret;
+	}
+	return 0;
+}
+
+// finished file, hand it to the hook without waiting for it
+static void Writer_FileClose(Writer_t* W)
+{
+	if (W->fd < 0) return;
+
+	bool IsStdout = (W->fd == STDOUT_FILENO);
+	if (!IsStdout) close(W->fd);
+	W->fd = -1;
+	W->FileCnt++;
+
+	// stdout has no file to hand over
+	if ((W->Config.OnClose == NULL) || IsStdout) return;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		char Cmd[1024];
+		snprintf(Cmd, sizeof(Cmd), "%s \"$1\"", W->Config.OnClose);
+		execl("/bin/sh", "sh", "-c", Cmd, "sh", (char*)W->FilePath, (char*)NULL);
+		_exit(127);
+	}
+	if (pid < 0) fprintf(stderr, "on-close hook failed [%s] errno:%i %s\n", W->FilePath, errno, strerror(errno));
+
+	// reap hooks that have finished
+	while (waitpid(-1, NULL, WNOHANG) > 0);
+}
+
+// O_DIRECT falls back to buffered on filesystems without it
+static int Writer_FileOpen(Writer_t* W, const u8* Path)
+{
+	Writer_FileClose(W);
+
+	strncpy((char*)W->FilePath, (const char*)Path, sizeof(W->FilePath) - 1);
+
+	int Flag = O_WRONLY | O_CREAT | O_TRUNC;
+
+	W->IsDirectFile = false;
+	if (W->Config.IsDirect)
+	{
+		W->fd = open64((char*)Path, Flag | O_DIRECT, 0666);
+		if (W->fd < 0) fprintf(stderr, "O_DIRECT not available on [%s] errno:%i %s, using buffered writes\n", Path, errno, strerror(errno));
+		else W->IsDirectFile = true;
+	}
+	if (W->fd < 0) W->fd = open64((char*)Path, Flag, 0666);
+	if (W->fd < 0)
+	{
+		fprintf(stderr, "failed to create [%s] errno:%i %s\n", Path, errno, strerror(errno));
+		return -1;
+	}
+	fprintf(stderr, "Output [%s]\n", Path);
+
+	return 0;
+}
+
+static void* Writer_Thread(void* Arg)
+{
+	Writer_t* W = (Writer_t*)Arg;
+
+	pthread_mutex_lock(&W->Lock);
+	while (true)
+	{
+		if (W->BlockGet == W->BlockPut)
+		{
+			if (W->IsExit) break;
+
+			pthread_cond_wait(&W->Cond, &W->Lock);
+			continue;
+		}
+		pthread_mutex_unlock(&W->Lock);
+
+		WriterBlock_t* B = &W->Block[W->BlockGet % W->BlockCnt];
+
+		// first block of a new file
+		if (B->Path[0] != 0)
+		{
+			if (!W->IsError && (Writer_FileOpen(W, B->Path) < 0)) W->IsError = true;
+			B->Path[0] = 0;
+		}
+
+		// O_DIRECT needs aligned lengths, only the final block can be short
+		if (W->IsDirectFile && (B->Length % WRITER_ALIGN) != 0)
+		{
+			int Flag = fcntl(W->fd, F_GETFL);
+			fcntl(W->fd, F_SETFL, Flag & ~O_DIRECT);
+			W->IsDirectFile = false;
+		}
+
+		u64 TSC0 = rdtsc();
+		if (!W->IsError && (Writer_WriteAll(W, B->Buffer, B->Length) < 0))
+		{
+			W->IsError = true;
+		}
+		W->WriteTSC 	+= rdtsc() - TSC0;
+		W->WriteByte	+= B->Length;
+
+		pthread_mutex_lock(&W->Lock);
+		W->BlockGet++;
+		pthread_cond_broadcast(&W->Cond);
+	}
+	pthread_mutex_unlock(&W->Lock);
+
+	Writer_FileClose(W);
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+static int Writer_Open(Writer_t* W, const WriterConfig_t* Config)
+{
+	memset(W, 0, sizeof(Writer_t));
+	W->Config	= *Config;
+	W->fd		= -1;
+
+	if ((Config->Path == NULL) && ((Config->RotateByte != 0) || (Config->RotateNS != 0)))
+	{
+		fprintf(stderr, "file rotation needs an output file prefix -o <prefix>\n");
+		return -1;
+	}
+	if ((Config->Path == NULL) && (Config->OnClose != NULL))
+	{
+		fprintf(stderr, "on-close hook needs an output file -o <file>\n");
+		return -1;
+	}
+
+	// stdout is open from the start, files open with their first block
+	if (Config->Path == NULL)
+	{
+		W->fd = STDOUT_FILENO;
+		strncpy((char*)W->FilePath, "stdout", sizeof(W->FilePath));
+	}
+
+	W->BlockSize = (Config->BlockSize + WRITER_ALIGN - 1) & ~(u64)(WRITER_ALIGN - 1);
+	W->BlockCnt	 = Config->QueueSize / W->BlockSize;
+	if (W->BlockCnt < 2) W->BlockCnt = 2;
+
+	W->Block = (WriterBlock_t*)calloc(W->BlockCnt, sizeof(WriterBlock_t));
+	for (int i=0; i < W->BlockCnt; i++)
+	{
+		if (posix_memalign((void**)&W->Block[i].Buffer, WRITER_ALIGN, W->BlockSize) != 0)
+		{
+			fprintf(stderr, "failed to allocate write block %lli B\n", W->BlockSize);
+			return -1;
+		}
+	}
+	fprintf(stderr, "Write queue %i x %lli MB blocks\n", W->BlockCnt, W->BlockSize / (1024*1024));
+
+	pthread_mutex_init(&W->Lock, NULL);
+	pthread_cond_init(&W->Cond, NULL);
+	pthread_create(&W->Thread, NULL, Writer_Thread, W);
+
+	W->StartTSC = rdtsc();
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// queue the block being filled, then wait for the next one to be free
+static void Writer_Submit(Writer_t* W)
+{
+	if (W->BlockPos == 0) return;
+
+	pthread_mutex_lock(&W->Lock);
+
+	W->Block[W->BlockPut % W->BlockCnt].Length = W->BlockPos;
+	W->BlockPut++;
+	pthread_cond_broadcast(&W->Cond);
+
+	if (W->BlockPut - W->BlockGet > W->QueueMax) W->QueueMax = W->BlockPut - W->BlockGet;
+
+	if (W->BlockPut - W->BlockGet >= W->BlockCnt)
+	{
+		u64 TSC0 = rdtsc();
+		while (W->BlockPut - W->BlockGet >= W->BlockCnt)
+		{
+			pthread_cond_wait(&W->Cond, &W->Lock);
+		}
+		W->StallCnt++;
+		W->StallTSC += rdtsc() - TSC0;
+	}
+	pthread_mutex_unlock(&W->Lock);
+
+	W->BlockPos = 0;
+}
+
+// copy into the blocks, queuing each one as it fills
+static void Writer_Append(Writer_t* W, const void* Data, u64 Length)
+{
+	const u8* Src = (const u8*)Data;
+
+	W->FileByte += Length;
+	while (Length > 0)
+	{
+		if (W->BlockPos == 0) W->BlockTSC = rdtsc();
+
+		u64 Copy = W->BlockSize - W->BlockPos;
+		if (Copy > Length) Copy = Length;
+
+		memcpy(W->Block[W->BlockPut % W->BlockCnt].Buffer + W->BlockPos, Src, Copy);
+		W->BlockPos += Copy;
+		Src			+= Copy;
+		Length		-= Copy;
+
+		if (W->BlockPos == W->BlockSize) Writer_Submit(W);
+	}
+}
+
+// start a file with its pcap header. rotated files are named after the first packet 
+// <prefix>_YYYYMMDD_HHMMSS.nnnnnnnnn.pcap in UTC
+static void Writer_FileStart(Writer_t* W, u64 TS)
+{
+	// the file starts on a block of its own
+	Writer_Submit(W);
+
+	WriterBlock_t* B = &W->Block[W->BlockPut % W->BlockCnt];
+	if ((W->Config.RotateByte != 0) || (W->Config.RotateNS != 0))
+	{
+		time_t Sec = TS / (u64)1e9;
+		struct tm t;
+		gmtime_r(&Sec, &t);
+
+		snprintf((char*)B->Path, sizeof(B->Path), "%s_%04i%02i%02i_%02i%02i%02i.%09lli.pcap",
+				W->Config.Path,
+				t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+				t.tm_hour, t.tm_min, t.tm_sec,
+				TS % (u64)1e9);
+	}
+	else if (W->Config.Path != NULL)
+	{
+		strncpy((char*)B->Path, (const char*)W->Config.Path, sizeof(B->Path) - 1);
+	}
+
+	W->IsFile	= true;
+	W->FileByte	= 0;
+	W->FileTS	= TS;
+
+	PCAPHeader_t Header;
+	Header.Magic 		= PCAPHEADER_MAGIC_NANO;
+	Header.Major 		= PCAPHEADER_MAJOR;
+	Header.Minor 		= PCAPHEADER_MINOR;
+	Header.TimeZone 	= 0;
+	Header.SigFlag 		= 0;
+	Header.SnapLen 		= 0xffff;
+	Header.Link 		= PCAPHEADER_LINK_ETHERNET;
+	Writer_Append(W, &Header, sizeof(Header));
+}
+
+// pcap record straight from the ring slot. its only kept once Writer_Commit is called, so 
+// a reader can drop a copy it finds torn. a record crossing the end of the block is staged
+// as the full block is queued straight away
+static void Writer_Packet(Writer_t* W, const fFMADRingPacket_t* RingPkt)
+{
+	// slot may be re-written under it, read the length once
+	u32 LengthCapture = RingPkt->LengthCapture;
+	if (LengthCapture > FMADRING_ENTRYSIZE) LengthCapture = FMADRING_ENTRYSIZE;
+
+	u64 RecordByte = sizeof(PCAPPacket_t) + LengthCapture;
+
+	// size limit or the packet is in the next time interval
+	bool IsRotate = !W->IsFile;
+	if ((W->Config.RotateByte != 0) && (W->FileByte + RecordByte > W->Config.RotateByte) && (W->FileByte > sizeof(PCAPHeader_t))) IsRotate = true;
+	if ((W->Config.RotateNS != 0) && (RingPkt->TS / W->Config.RotateNS != W->FileTS / W->Config.RotateNS)) IsRotate = true;
+
+	if (IsRotate) Writer_FileStart(W, RingPkt->TS);
+
+	// convert 64b epoch into sec/subsec for pcap
+	PCAPPacket_t Pkt;
+	Pkt.Sec 			= RingPkt->TS / (u64)1e9;
+	Pkt.NSec 			= RingPkt->TS % (u64)1e9;
+	Pkt.LengthCapture	= LengthCapture;
+	Pkt.LengthWire		= RingPkt->LengthWire;
+
+	W->IsRecordStaged	= (W->BlockPos + RecordByte > W->BlockSize);
+	W->RecordByte		= RecordByte;
+
+	u8* Dst = W->IsRecordStaged ? W->Record : W->Block[W->BlockPut % W->BlockCnt].Buffer + W->BlockPos;
+	memcpy(Dst, &Pkt, sizeof(PCAPPacket_t));
+	memcpy(Dst + sizeof(PCAPPacket_t), RingPkt->Payload, LengthCapture);
+}
+
+// keep the record from Writer_Packet
+static void Writer_Commit(Writer_t* W)
+{
+	if (W->IsRecordStaged)
+	{
+		Writer_Append(W, W->Record, W->RecordByte);
+	}
+	else
+	{
+		if (W->BlockPos == 0) W->BlockTSC = rdtsc();
+
+		W->BlockPos	+= W->RecordByte;
+		W->FileByte	+= W->RecordByte;
+
+		if (W->BlockPos == W->BlockSize) Writer_Submit(W);
+	}
+	W->RecordByte = 0;
+}
+
+// ring is idle, push a partial block out so a pipe reader is not kept waiting. 
+// O_DIRECT files keep full blocks
+static void Writer_Idle(Writer_t* W)
+{
+	if (W->Config.IsDirect || (W->BlockPos == 0)) return;
+	if (tsc2ns(rdtsc() - W->BlockTSC) < WRITER_FLUSH_NS) return;
+
+	Writer_Submit(W);
+}
+
+// write everything queued, close the last file and stop the writer
+static void Writer_Close(Writer_t* W)
+{
+	Writer_Submit(W);
+
+	pthread_mutex_lock(&W->Lock);
+	W->IsExit = true;
+	pthread_cond_broadcast(&W->Cond);
+	pthread_mutex_unlock(&W->Lock);
+
+	pthread_join(W->Thread, NULL);
+
+	// let the hooks finish
+	while (wait(NULL) > 0);
+
+	for (int i=0; i < W->BlockCnt; i++) free(W->Block[i].Buffer);
+	free(W->Block);
+}
 
 //------------------------------------------------------------------------------
 static void help(void)
@@ -46,8 +488,20 @@ static void help(void)
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:>\n");
 	fprintf(stderr, "   -i <path to fmadio ring file>    : location of fmad ring file\n");
-	fprintf(stderr, "   --cpu <cpu number>               : pin the process on the specified CPU\n");
+	fprintf(stderr, "   --cpu <cpu number|auto>          : pin the process on the specified CPU, auto picks one local to the rings NUMA node\n");
 	fprintf(stderr, "   --no-sleep                       : use ndelay for a tight busy polly loop\n");
+	fprintf(stderr, "   --cursor <name>                  : attach as a named reader, every reader sees all packets\n");
+	fprintf(stderr, "   --shard <n>                      : read shard n of a ring set written with pcap2fmadio --ring-set\n");
+	fprintf(stderr, "   --resume                         : continue from where the reader left off instead of the write pointer\n");
+	fprintf(stderr, "   -o <file>                        : write the pcap to a file instead of STDOUT\n");
+	fprintf(stderr, "   --direct                         : open the -o file with O_DIRECT, bypassing the page cache\n");
+	fprintf(stderr, "   --block <MB>                     : size of each output write (default 8)\n");
+	fprintf(stderr, "   --queue <MB>                     : memory queued between the ring reader and the file writer (default 256)\n");
+	fprintf(stderr, "   --rotate-size <MB>               : start a new file past this size, -o is the file name prefix\n");
+	fprintf(stderr, "   --rotate-time <sec>              : start a new file every interval of packet time, -o is the file name prefix\n");
+	fprintf(stderr, "   --on-close <command>             : run '<command> <file>' on each finished file e.g. \"xz -T0\", needs -o\n");
+	fprintf(stderr, "   --bpf <filter>                   : only write packets matching the filter, a tcpdump expression (built WITH_PCAP)\n");
+	fprintf(stderr, "                                      or the output of tcpdump -ddd '<expression>', @<file> reads it from a file\n");
 	fprintf(stderr, "\n");
 }
 
@@ -68,6 +522,7 @@ int main(int argc, char* argv[])
 	fprintf(stderr, "fmadio2pcap\n");
 
 	int CPU = -1;
+	int Shard = -1;
 	for (int i=0; i < argc; i++)
 	{
 		// location of shm ring file 
@@ -84,7 +539,7 @@ int main(int argc, char* argv[])
 			fprintf(stderr, "setting cpu affinity\n");
 			if (argv[i+1] != NULL) 
 			{
-				CPU = atoi( argv[i+1] );
+				CPU = (strcmp(argv[i+1], "auto") == 0) ? FMADRING_CPU_AUTO : atoi( argv[i+1] );
 			}
 			else 
 			{
@@ -96,6 +551,76 @@ int main(int argc, char* argv[])
 		{
 			s_NoSleep = true;
 		}
+		// independent reader 
+		if (strcmp(argv[i], "--cursor") == 0)
+		{
+			s_CursorName = argv[i+1];
+			fprintf(stderr, "Reader [%s]\n", s_CursorName);
+		}
+
+		// pick up packets queued since the reader last ran 
+		if (strcmp(argv[i], "--resume") == 0)
+		{
+			s_IsResume = true;
+			fprintf(stderr, "Resume reader\n");
+		}
+
+		// write to a file instead of stdout
+		if (strcmp(argv[i], "-o") == 0)
+		{
+			s_OutPath = argv[i+1];
+			fprintf(stderr, "Output [%s]\n", s_OutPath);
+		}
+		// bypass the page cache
+		if (strcmp(argv[i], "--direct") == 0)
+		{
+			s_IsDirect = true;
+			fprintf(stderr, "O_DIRECT output\n");
+		}
+		// output write size
+		if (strcmp(argv[i], "--block") == 0)
+		{
+			s_BlockSize = strtoull(argv[i+1], NULL, 0) * 1024 * 1024;
+			if (s_BlockSize == 0) s_BlockSize = 1024 * 1024;
+			fprintf(stderr, "Write block %lli MB\n", s_BlockSize / (1024*1024));
+		}
+		// ring reader to file writer queue
+		if (strcmp(argv[i], "--queue") == 0)
+		{
+			s_QueueSize = strtoull(argv[i+1], NULL, 0) * 1024 * 1024;
+			fprintf(stderr, "Write queue %lli MB\n", s_QueueSize / (1024*1024));
+		}
+		// file rotation
+		if (strcmp(argv[i], "--rotate-size") == 0)
+		{
+			s_RotateByte = strtoull(argv[i+1], NULL, 0) * 1024 * 1024;
+			fprintf(stderr, "Rotate every %lli MB\n", s_RotateByte / (1024*1024));
+		}
+		if (strcmp(argv[i], "--rotate-time") == 0)
+		{
+			s_RotateNS = strtoull(argv[i+1], NULL, 0) * (u64)1e9;
+			fprintf(stderr, "Rotate every %lli sec\n", s_RotateNS / (u64)1e9);
+		}
+		// hand finished files on
+		if (strcmp(argv[i], "--on-close") == 0)
+		{
+			s_OnClose = argv[i+1];
+			fprintf(stderr, "On close [%s]\n", s_OnClose);
+		}
+
+		// packet filter
+		if (strcmp(argv[i], "--bpf") == 0)
+		{
+			s_BPF = FMADBPF_Compile(argv[i+1]);
+			if (s_BPF == NULL) return 0;
+		}
+
+		// single ring of a flow hashed ring set
+		if (strcmp(argv[i], "--shard") == 0)
+		{
+			Shard = atoi(argv[i+1]);
+			fprintf(stderr, "Shard [%i]\n", Shard);
+		}
 
 		if (strcmp(argv[i], "--help") == 0)
 		{
@@ -110,48 +635,72 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
-	if (CPU != -1)
+	// -i is the base path of the set
+	static u8 ShardPath[256];
+	if (Shard >= 0)
 	{
-		cpu_set_t  mask;
-
-		CPU_ZERO(&mask);
-		CPU_SET(CPU, &mask);
-		sched_setaffinity(0, sizeof(mask), &mask);
+		FMADPacket_RingShardPath(ShardPath, sizeof(ShardPath), s_RINGPath, Shard);
+		s_RINGPath = ShardPath;
+		fprintf(stderr, "FMAD Ring [%s]\n", s_RINGPath);
 	}
 
 	//map the ring file
-	if (FMADPacket_OpenRx(&s_RINGfd, &s_RING, true, s_RINGPath) < 0)
+	int rc = 0;
+	if (s_IsResume)
+	{
+		u64 BacklogPkt	= 0;
+		u64 LostPkt		= 0;
+		rc = FMADPacket_OpenRxResume(&s_RINGfd, &s_RING, &s_Cursor, s_RINGPath, s_CursorName, &BacklogPkt, &LostPkt);
+		if (rc == 0) fprintf(stderr, "resumed backlog %lli pkts lost %lli pkts\n", BacklogPkt, LostPkt);
+	}
+	else
+	{
+		rc = FMADPacket_OpenRxCursor(&s_RINGfd, &s_RING, &s_Cursor, s_RINGPath, s_CursorName);
+	}
+	if (rc < 0)
 	{
 		fprintf(stderr, "failed to open FMAD Ring [%s]\n", s_RINGPath);	
 		return 0;
 	}
 
+	// pin local to the ring memory
+	CPU = FMADPacket_NUMACPU(s_RING, CPU);
+	if (CPU != -1)
+	{
+		cpu_set_t  mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(CPU, &mask);
+		sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
 	// signal handlers
 	signal(SIGINT,  signal_handler);
 	signal(SIGHUP,  signal_handler);
 	signal(SIGPIPE, signal_handler);
 
-	// write file to stoud
-	FILE* FPCAP 		= stdout; 
+	// ring reader queues blocks to the file writer thread
+	WriterConfig_t WriterConfig;
+	memset(&WriterConfig, 0, sizeof(WriterConfig));
+	WriterConfig.Path		= s_OutPath;
+	WriterConfig.IsDirect	= s_IsDirect;
+	WriterConfig.BlockSize	= s_BlockSize;
+	WriterConfig.QueueSize	= s_QueueSize;
+	WriterConfig.RotateByte	= s_RotateByte;
+	WriterConfig.RotateNS	= s_RotateNS;
+	WriterConfig.OnClose	= s_OnClose;
 
-	// write pcap header
-	PCAPHeader_t Header;
-	Header.Magic 		= PCAPHEADER_MAGIC_NANO;
-	Header.Major 		= PCAPHEADER_MAJOR;
-	Header.Minor 		= PCAPHEADER_MINOR;
-	Header.TimeZone 	= 0;
-	Header.SigFlag 		= 0;
-	Header.SnapLen 		= 0xffff;
-	Header.Link 		= PCAPHEADER_LINK_ETHERNET;
-	fwrite(&Header, 1, sizeof(Header), FPCAP);
+	static Writer_t Writer;
+	if (Writer_Open(&Writer, &WriterConfig) < 0) return 0;
 
-	u32 PktBufferMax = 128*1024;
-	u8* PktBuffer = malloc(PktBufferMax);
-	memset(PktBuffer, 0, PktBufferMax);
+	// single output gets its pcap header now, rotated files when their first packet arrives
+	if ((s_RotateByte == 0) && (s_RotateNS == 0)) Writer_FileStart(&Writer, 0);
 
 	u64 TotalPkt 	= 0;
 	u64 TotalByte 	= 0;
 	u64 TotalPktFCS	= 0;			// total number of packets with FCS errors
+	u64 TotalPktBPF	= 0;			// total number of packets dropped by the filter
+	u64 TotalPktTorn= 0;			// total number of packets re-written by the producer while read
 
 	u32 LastSec		= 0;
 	u64 LastTS		= 0;
@@ -160,59 +709,95 @@ int main(int argc, char* argv[])
 
 	while (!s_Exit)
 	{
-		u64 TS;
-		PCAPPacket_t* Pkt	= (PCAPPacket_t*)PktBuffer;
-
-		u32 PktFlag = 0;
+		fFMADRingBatch_t Batch;
 
-		// fetch packet from ring without blocking
-		int ret = FMADPacket_RecvV1(s_RING, false, &TS, &Pkt->LengthWire, &Pkt->LengthCapture, NULL, &PktFlag, Pkt + 1);
+		// fetch a batch of packets from ring without blocking. payload stays in the ring slots 
+		int ret = FMADPacket_RecvBatchCursor(s_RING, s_Cursor, false, &Batch, FMADRING_BATCH_MAX);
 
 		// if it has valid data
-		if (ret > 0)
+		for (int i=0; i < ret; i++)
 		{
+			const fFMADRingPacket_t* RingPkt = Batch.Pkt[i];
+
 			// count flaged FCS packets
-			if (PktFlag & FMADRING_FLAG_FCSERR)
+			if (RingPkt->Flag & FMADRING_FLAG_FCSERR)
 			{
 				TotalPktFCS++;
 			}
 
-			// santize it
-			assert(Pkt->LengthCapture > 0);	
-			assert(Pkt->LengthCapture < 16*1024);	
+			// filter on the ring slot before anything is copied
+			if ((s_BPF != NULL) && !FMADBPF_Packet(s_BPF, RingPkt))
+			{
+				TotalPktBPF++;
+				continue;
+			}
 
-			// convert 64b epoch into sec/subsec for pcap
-			Pkt->Sec 			= TS / (u64)1e9;
-			Pkt->NSec 			= TS % (u64)1e9;
+			// PCAP header and payload directly from the ring slot. the length is not checked 
+			// here, on an overwrite ring the slot may be mid re-write. Writer_Packet clamps it
+			// and the torn check below drops the record
+			Writer_Packet(&Writer, RingPkt);
 
-			// write PCAP header and payload 	
-			fwrite(PktBuffer, 1, sizeof(PCAPPacket_t) + Pkt->LengthCapture, FPCAP); 
+			// producer without flow control re-wrote the slot during the copy, drop the record
+			if (!FMADPacket_RecvBatchCheck(s_RING, s_Cursor, &Batch, i))
+			{
+				TotalPktTorn++;
+				continue;
+			}
+			Writer_Commit(&Writer);
+		}	
 
+		// slots can be re-used by the producer
+		if (ret > 0)
+		{
 			// general stats
-			TotalPkt 	+= 1;
-			TotalByte 	+= ret;
-		}	
+			TotalPkt 	+= Batch.PktCnt;
+			TotalByte 	+= Batch.Byte;
+
+			TotalPktTorn += FMADPacket_RecvBatchReleaseCursor(s_RING, s_Cursor, &Batch);
+		}
 
 		// end of stream
 		if (ret < 0) break;
 
-		// request is nonblocking, run less hot, use usleep(0) to reduce cpu usage more 
+		// output is gone
+		if (Writer.IsError) break;
+
+		// request is nonblocking, run less hot. sleeps on the rings futex if it has one 
 		if (ret == 0)
 		{
+			Writer_Idle(&Writer);
+
 			if (s_NoSleep)
 			{
 				ndelay(100);
 			}
 			else
 			{
-				usleep(0);
+				FMADPacket_RecvSleep(s_RING, s_Cursor, 100e6);
 			}
 		}
 	}
-	fflush(stdout);
+
+	// producer no longer waits for this reader
+	FMADPacket_CursorDetach(s_RING, s_Cursor);
+
+	Writer_Close(&Writer);
 
 	// summary stats 
-	fprintf(stderr, "TotalPkt: %lli TotalByte:%lli TotalFCSError:%lli\n", TotalPkt, TotalByte, TotalPktFCS);
+	fprintf(stderr, "TotalPkt: %lli TotalByte:%lli TotalFCSError:%lli TotalFiltered:%lli TotalTorn:%lli\n", TotalPkt, TotalByte, TotalPktFCS, TotalPktBPF, TotalPktTorn);
+
+	// disk rate is while inside write(), overall includes waiting for packets
+	double WriteSec = tsc2ns(Writer.WriteTSC) / 1e9;
+	double TotalSec = tsc2ns(rdtsc() - Writer.StartTSC) / 1e9;
+	fprintf(stderr, "Write: %.3f GB %.3f GB/s overall %.3f GB/s Files:%lli QueueMax:%lli/%i Stall:%lli %.3f sec\n", 
+			Writer.WriteByte / 1e9,
+			(WriteSec > 0) ? Writer.WriteByte / WriteSec / 1e9 : 0.0,
+			(TotalSec > 0) ? Writer.WriteByte / TotalSec / 1e9 : 0.0,
+			Writer.FileCnt,
+			Writer.QueueMax,
+			Writer.BlockCnt,
+			Writer.StallCnt,
+			tsc2ns(Writer.StallTSC) / 1e9);
 
 	return 0;
 }
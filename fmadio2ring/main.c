@@ -0,0 +1,662 @@
+//-------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// Ring to ring forwarder. Reads one FMADIO ring and republishes the packets to one or more
+// output rings, each with its own filter, sampling and snaplen. Input slots are not copied,
+// the output descriptors point straight into them so each packet is copied once, into the
+// output slot
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+
+#include <arpa/inet.h>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+
+#include "include/fmadio_packet.h"
+#include "include/fmadio_bpf.h"
+
+//------------------------------------------------------------------------------
+
+#define OUTPUT_MAX					16						// max output rings
+
+typedef struct Output_t
+{
+	u8*						Path;							// output ring file
+	int						fd;								// ring file handle
+	fFMADRingHeader_t*		RING;							// mapping
+
+	// filter, every set field must match
+	s32						Port;							// capture port, -1 any
+	s32						EtherType;						// ethertype after vlan/mpls, -1 any
+	s32						IPProto;						// IPv4 protocol / IPv6 next header, -1 any
+	u32						IPLength;						// 4 or 16 byte address, 0 any
+	u32						IPPrefix;						// prefix bits of IPAddr to compare
+	u8						IPAddr[16];						// source or destination address
+	s32						L4Port;							// TCP/UDP/SCTP source or destination port, -1 any
+	fFMADBPF_t*				BPF;							// packet filter, NULL any
+
+	u32						SampleN;						// forward 1 in N matching packets, 0 all
+	u32						SampleFlowN;					// forward 1 in N flows by flow hash, 0 all
+	u32						SnapLen;						// truncate the capture, 0 full packet
+
+	bool					IsMeta;							// filter needs the parsed headers
+	u64						SampleCnt;						// matching packets seen for 1 in N
+
+	fFMADRingSendDesc_t		Desc[FMADRING_BATCH_MAX];		// pending burst for the output
+	u32						DescCnt;
+
+	u64						PktCnt;							// packets forwarded
+	u64						Byte;							// capture bytes forwarded
+	u64						DropCnt;						// packets lost to flow control timeout or a full output
+
+} Output_t;
+
+static u8*					s_RINGPath	= NULL;				// input ring
+static int					s_RINGfd;						// ring file handle
+static fFMADRingHeader_t*	s_RING		= NULL;  			// mapping
+static u8*					s_CursorName= NULL;				// named reader, NULL for the default reader
+static fFMADRingCursor_t*	s_Cursor	= NULL;				// read position
+static bool					s_NoSleep	= false;			// busy poll the input
+static bool					s_IsResume	= false;			// continue from the readers last position
+
+static Output_t				s_Output[OUTPUT_MAX];			// output rings
+static u32					s_OutputCnt	= 0;
+
+static fFMADRingPacket_t	s_Stage[FMADRING_BATCH_MAX];	// packets copied out of an input without flow control
+
+//------------------------------------------------------------------------------
+static void help(void)
+{
+	fprintf(stderr, "fmadio2ring <options>\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Forwards packets from one FMADIO Ring buffer to one or more output rings\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Example: (tcp port 80 on port 0 to one ring, 1 in 100 of everything to another)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "fmadio2ring -i /opt/fmadio/queue/lxc_ring0 -o /dev/shm/web --port 0 --proto 6 --l4port 80 -o /dev/shm/sample --sample 100\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:>\n");
+	fprintf(stderr, "   -i <path to fmadio ring file>    : input ring\n");
+	fprintf(stderr, "   --cpu <cpu number|auto>          : pin the process on the specified CPU, auto picks one local to the input rings NUMA node\n");
+	fprintf(stderr, "   --no-sleep                       : use ndelay for a tight busy polly loop\n");
+	fprintf(stderr, "   --cursor <name>                  : attach to the input as a named reader\n");
+	fprintf(stderr, "   --resume                         : continue from where the reader left off instead of the write pointer\n");
+	fprintf(stderr, "   --disable-eof                    : do not pass the input EOF to the outputs\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Output rings, created if they do not exist:\n");
+	fprintf(stderr, "   -o <path to fmadio ring file>    : add an output ring, the per output options below apply to the last -o\n");
+	fprintf(stderr, "   --packed                         : create the outputs in the packed variable length format\n");
+	fprintf(stderr, "   --depth <integer>                : number of slots when creating the outputs (power of 2)\n");
+	fprintf(stderr, "   --packed-size <integer>          : packed ring data size in MB when creating the outputs (power of 2)\n");
+	fprintf(stderr, "   --flow-control                   : outputs wait for their readers, a slow reader stalls the forwarder\n");
+	fprintf(stderr, "   --futex                          : create the outputs so idle readers sleep on a futex\n");
+	fprintf(stderr, "   --meta                           : create the outputs with per packet header metadata\n");
+	fprintf(stderr, "   --latency                        : create the outputs with per packet TSC stamps\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Per output:\n");
+	fprintf(stderr, "   --port <n>                       : capture port\n");
+	fprintf(stderr, "   --ethertype <hex>                : ethertype after vlan/mpls tags e.g. 0x0800\n");
+	fprintf(stderr, "   --ip <addr[/prefix]>             : IPv4 or IPv6 source or destination address\n");
+	fprintf(stderr, "   --proto <n>                      : IP protocol e.g. 6 tcp, 17 udp\n");
+	fprintf(stderr, "   --l4port <n>                     : TCP/UDP/SCTP source or destination port\n");
+	fprintf(stderr, "   --bpf <filter>                   : tcpdump expression (built WITH_PCAP) or tcpdump -ddd output, @<file> reads it from a file\n");
+	fprintf(stderr, "   --sample <n>                     : forward 1 in n matching packets\n");
+	fprintf(stderr, "   --sample-flow <n>                : forward 1 in n flows, every packet of a sampled flow\n");
+	fprintf(stderr, "   --snaplen <n>                    : truncate forwarded packets to n bytes\n");
+	fprintf(stderr, "\n");
+}
+
+//------------------------------------------------------------------------------
+// signal handler for clean exit
+volatile bool s_Exit 		= false;
+static void signal_handler(int sig)
+{
+	fprintf(stderr, "ctrl-c\n");
+	s_Exit  = true;
+}
+
+//------------------------------------------------------------------------------
+// addr[/prefix] to a 4 or 16 byte address
+static int ParseIP(Output_t* O, const char* Arg)
+{
+	char Addr[64];
+	strncpy(Addr, Arg, sizeof(Addr) - 1);
+	Addr[sizeof(Addr) - 1] = 0;
+
+	int Prefix = -1;
+	char* Slash = strchr(Addr, '/');
+	if (Slash != NULL)
+	{
+		*Slash = 0;
+		Prefix = atoi(Slash + 1);
+	}
+
+	if (inet_pton(AF_INET, Addr, O->IPAddr) == 1)		O->IPLength = 4;
+	else if (inet_pton(AF_INET6, Addr, O->IPAddr) == 1)	O->IPLength = 16;
+	else return -1;
+
+	if ((Prefix < 0) || (Prefix > O->IPLength * 8)) Prefix = O->IPLength * 8;
+	O->IPPrefix = Prefix;
+
+	return 0;
+}
+
+// first Bits of A and B are equal
+static bool PrefixMatch(const u8* A, const u8* B, u32 Bits)
+{
+	u32 Bytes = Bits / 8;
+	if (memcmp(A, B, Bytes) != 0) return false;
+
+	u32 Rem = Bits & 7;
+	if (Rem == 0) return true;
+
+	u8 Mask = 0xff << (8 - Rem);
+	return ((A[Bytes] ^ B[Bytes]) & Mask) == 0;
+}
+
+//------------------------------------------------------------------------------
+// packet passes the outputs filter and sampling
+static bool OutputMatch(Output_t* O, const fFMADRingPacket_t* Pkt, const fFMADRingMeta_t* Meta)
+{
+	if ((O->Port >= 0) && (Pkt->Port != O->Port)) return false;
+
+	if (O->IsMeta)
+	{
+		if ((Meta->Flag & FMADRING_META_VALID) == 0) return false;
+
+		if ((O->EtherType >= 0) && (Meta->EtherType != O->EtherType)) return false;
+
+		if (O->IPLength != 0)
+		{
+			const u8* IP = Pkt->Payload + Meta->L3Offset;
+
+			// source address at 12/8 destination 16/24 for IPv4/IPv6
+			if (O->IPLength == 4)
+			{
+				if ((Meta->EtherType != 0x0800) || (Meta->L3Offset + 20 > Pkt->LengthCapture)) return false;
+				if (!PrefixMatch(IP + 12, O->IPAddr, O->IPPrefix) && !PrefixMatch(IP + 16, O->IPAddr, O->IPPrefix)) return false;
+			}
+			else
+			{
+				if ((Meta->EtherType != 0x86dd) || (Meta->L3Offset + 40 > Pkt->LengthCapture)) return false;
+				if (!PrefixMatch(IP +  8, O->IPAddr, O->IPPrefix) && !PrefixMatch(IP + 24, O->IPAddr, O->IPPrefix)) return false;
+			}
+		}
+
+		if ((O->IPProto >= 0) && ((Meta->EtherType != 0x0800) && (Meta->EtherType != 0x86dd))) return false;
+		if ((O->IPProto >= 0) && (Meta->IPProto != O->IPProto)) return false;
+
+		// only the first fragment has the transport header
+		if (O->L4Port >= 0)
+		{
+			u32 Proto = Meta->IPProto;
+			if ((Proto != 6) && (Proto != 17) && (Proto != 132)) return false;
+			if ((Meta->L4Offset == 0) || (Meta->L4Offset + 4 > Pkt->LengthCapture)) return false;
+
+			const u8* L4 = Pkt->Payload + Meta->L4Offset;
+			if ((FMADPacket_Load16(L4 + 0) != O->L4Port) && (FMADPacket_Load16(L4 + 2) != O->L4Port)) return false;
+		}
+
+		// flow hash is symmetric so both directions of a flow are kept
+		if ((O->SampleFlowN > 1) && ((Meta->FlowHash % O->SampleFlowN) != 0)) return false;
+	}
+
+	// after the cheaper checks
+	if ((O->BPF != NULL) && !FMADBPF_Packet(O->BPF, Pkt)) return false;
+
+	if (O->SampleN > 1)
+	{
+		return (O->SampleCnt++ % O->SampleN) == 0;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// send the outputs pending burst. payloads point into input slots so this runs
+// before the input batch is released
+static void OutputFlush(Output_t* O)
+{
+	if (O->DescCnt == 0) return;
+
+	// a timeout part way through has still sent the start of the burst
+	int ret = FMADPacket_SendBatch(O->RING, O->Desc, O->DescCnt);
+	u32 SendCnt = (ret > 0) ? ret : 0;
+
+	O->PktCnt	+= SendCnt;
+	O->DropCnt	+= O->DescCnt - SendCnt;
+	for (int i=0; i < SendCnt; i++) O->Byte += O->Desc[i].LengthCapture;
+
+	O->DescCnt = 0;
+}
+
+//------------------------------------------------------------------------------
+// a producer without flow control can re-write an input slot while its forwarded. the packet
+// is copied out and its slot checked before any output sees it, false if the copy is torn 
+// and the packet was counted as lost. a flow controlled input is forwarded zero copy
+static bool InputStage(fFMADRingBatch_t* Batch, u32 Index)
+{
+	const fFMADRingPacket_t* Pkt = Batch->Pkt[Index];
+	fFMADRingPacket_t* S = &s_Stage[Index];
+
+	// read the length once
+	u32 LengthCapture = Pkt->LengthCapture;
+	if (LengthCapture > FMADRING_ENTRYSIZE) LengthCapture = FMADRING_ENTRYSIZE;
+
+	S->TS				= Pkt->TS;
+	S->LengthWire		= Pkt->LengthWire;
+	S->LengthCapture	= LengthCapture;
+	S->Port				= Pkt->Port;
+	S->Flag				= Pkt->Flag;
+	S->StorageID		= Pkt->StorageID;
+	S->Meta				= Pkt->Meta;
+	memcpy(S->Payload, Pkt->Payload, LengthCapture);
+
+	return FMADPacket_RecvBatchCheck(s_RING, s_Cursor, Batch, Index);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	fprintf(stderr, "fmadio2ring\n");
+
+	int CPU 				= -1;
+	bool EnableEOFPacket	= true; 				// pass the EOF on to the outputs
+	u64 TxTimeoutNS 		= 1e9;					// flow control wait before a burst is dropped
+	bool IsFlowControl		= false;				// outputs wait for their readers
+	u32 RingVersion			= FMADRING_VERSION;		// output ring format to create
+	u64 RingDepth			= 0;					// slots in the ring, 0 for default/existing
+	u64 RingDataSize		= 0;					// packed ring bytes, 0 for default/existing
+	u32 RingFeature			= 0;					// FMADRING_FEATURE_* to create the outputs with
+
+	Output_t* O = NULL;
+	for (int i=1; i < argc; i++)
+	{
+		const char* Value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		// location of the input ring file
+		if (strcmp(argv[i], "-i") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `-i` expects a following file path argument\n"); return 1; }
+
+			s_RINGPath 		= (u8*)Value;
+			fprintf(stderr, "FMAD Ring [%s]\n", s_RINGPath);
+			i++;
+		}
+		// new output ring, per output options that follow apply to it
+		else if (strcmp(argv[i], "-o") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `-o` expects a following file path argument\n"); return 1; }
+			if (s_OutputCnt >= OUTPUT_MAX)
+			{
+				fprintf(stderr, "too many outputs, max %i\n", OUTPUT_MAX);
+				return 1;
+			}
+
+			O = &s_Output[s_OutputCnt++];
+			memset(O, 0, sizeof(Output_t));
+			O->Path			= (u8*)Value;
+			O->Port			= -1;
+			O->EtherType	= -1;
+			O->IPProto		= -1;
+			O->L4Port		= -1;
+
+			fprintf(stderr, "Output [%s]\n", O->Path);
+			i++;
+		}
+		else if (strcmp(argv[i], "--cpu") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `--cpu` expects a following integer argument\n"); return 1; }
+
+			CPU = (strcmp(Value, "auto") == 0) ? FMADRING_CPU_AUTO : atoi(Value);
+			fprintf(stderr, "Will pin thread to CPU %s.\n", Value);
+			i++;
+		}
+		else if (strcmp(argv[i], "--no-sleep") == 0)
+		{
+			s_NoSleep = true;
+		}
+		// independent reader
+		else if (strcmp(argv[i], "--cursor") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `--cursor` expects a following name argument\n"); return 1; }
+
+			s_CursorName = (u8*)Value;
+			fprintf(stderr, "Reader [%s]\n", s_CursorName);
+			i++;
+		}
+		// pick up packets queued since the reader last ran
+		else if (strcmp(argv[i], "--resume") == 0)
+		{
+			s_IsResume = true;
+			fprintf(stderr, "Resume reader\n");
+		}
+		else if (strcmp(argv[i], "--disable-eof") == 0)
+		{
+			fprintf(stderr, "Disable EOF packet\n");
+			EnableEOFPacket = false;
+		}
+
+		// output ring creation
+		else if (strcmp(argv[i], "--packed") == 0)
+		{
+			fprintf(stderr, "Packed ring format\n");
+			RingVersion = FMADRING_VERSION2;
+		}
+		else if (strcmp(argv[i], "--depth") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `--depth` expects a following integer argument\n"); return 1; }
+
+			RingDepth = strtoull(Value, NULL, 0);
+			fprintf(stderr, "Ring depth %lli\n", RingDepth);
+			i++;
+		}
+		else if (strcmp(argv[i], "--packed-size") == 0)
+		{
+			if (Value == NULL) { fprintf(stderr, "argument `--packed-size` expects a following integer argument\n"); return 1; }
+
+			RingDataSize = strtoull(Value, NULL, 0) * 1024 * 1024;
+			fprintf(stderr, "Packed ring size %lli MB\n", RingDataSize / (1024*1024));
+			i++;
+		}
+		else if (strcmp(argv[i], "--flow-control") == 0)
+		{
+			fprintf(stderr, "Flow controlled outputs\n");
+			IsFlowControl = true;
+		}
+		else if (strcmp(argv[i], "--futex") == 0)
+		{
+			fprintf(stderr, "Futex wait ring\n");
+			RingFeature |= FMADRING_FEATURE_FUTEX;
+		}
+		else if (strcmp(argv[i], "--meta") == 0)
+		{
+			fprintf(stderr, "Packet metadata ring\n");
+			RingFeature |= FMADRING_FEATURE_META;
+		}
+		else if (strcmp(argv[i], "--latency") == 0)
+		{
+			fprintf(stderr, "Latency stamped ring\n");
+			RingFeature |= FMADRING_FEATURE_LATENCY;
+		}
+
+		else if (strcmp(argv[i], "--help") == 0)
+		{
+			help();
+			return 0;
+		}
+
+		// per output settings
+		else if (O == NULL)
+		{
+			fprintf(stderr, "argument `%s` unknown or before the first -o\n", argv[i]);
+			return 1;
+		}
+		else if (Value == NULL)
+		{
+			fprintf(stderr, "argument `%s` unknown or missing its value\n", argv[i]);
+			return 1;
+		}
+		else if (strcmp(argv[i], "--port") == 0)
+		{
+			O->Port = atoi(Value);
+			fprintf(stderr, "  port %i\n", O->Port);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ethertype") == 0)
+		{
+			O->EtherType = strtoul(Value, NULL, 16);
+			O->IsMeta	 = true;
+			fprintf(stderr, "  ethertype 0x%04x\n", O->EtherType);
+			i++;
+		}
+		else if (strcmp(argv[i], "--ip") == 0)
+		{
+			if (ParseIP(O, Value) < 0)
+			{
+				fprintf(stderr, "argument `--ip` invalid address [%s]\n", Value);
+				return 1;
+			}
+			O->IsMeta = true;
+			fprintf(stderr, "  ip %s prefix %i\n", Value, O->IPPrefix);
+			i++;
+		}
+		else if (strcmp(argv[i], "--proto") == 0)
+		{
+			O->IPProto	= atoi(Value);
+			O->IsMeta	= true;
+			fprintf(stderr, "  proto %i\n", O->IPProto);
+			i++;
+		}
+		else if (strcmp(argv[i], "--l4port") == 0)
+		{
+			O->L4Port	= atoi(Value);
+			O->IsMeta	= true;
+			fprintf(stderr, "  l4port %i\n", O->L4Port);
+			i++;
+		}
+		else if (strcmp(argv[i], "--bpf") == 0)
+		{
+			O->BPF = FMADBPF_Compile(Value);
+			if (O->BPF == NULL) return 1;
+			i++;
+		}
+		else if (strcmp(argv[i], "--sample") == 0)
+		{
+			O->SampleN = atoi(Value);
+			fprintf(stderr, "  sample 1 in %i\n", O->SampleN);
+			i++;
+		}
+		else if (strcmp(argv[i], "--sample-flow") == 0)
+		{
+			O->SampleFlowN	= atoi(Value);
+			O->IsMeta		= true;
+			fprintf(stderr, "  sample 1 in %i flows\n", O->SampleFlowN);
+			i++;
+		}
+		else if (strcmp(argv[i], "--snaplen") == 0)
+		{
+			O->SnapLen = atoi(Value);
+			fprintf(stderr, "  snaplen %i\n", O->SnapLen);
+			i++;
+		}
+		else
+		{
+			fprintf(stderr, "argument `%s` unknown\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (s_RINGPath == NULL)
+	{
+		fprintf(stderr, "specify the input ring with -i <path to ring file>\n");
+		return 1;
+	}
+	if (s_OutputCnt == 0)
+	{
+		fprintf(stderr, "specify at least one output ring with -o <path to ring file>\n");
+		return 1;
+	}
+
+	// map the input
+	int rc = 0;
+	if (s_IsResume)
+	{
+		u64 BacklogPkt	= 0;
+		u64 LostPkt		= 0;
+		rc = FMADPacket_OpenRxResume(&s_RINGfd, &s_RING, &s_Cursor, s_RINGPath, s_CursorName, &BacklogPkt, &LostPkt);
+		if (rc == 0) fprintf(stderr, "resumed backlog %lli pkts lost %lli pkts\n", BacklogPkt, LostPkt);
+	}
+	else
+	{
+		rc = FMADPacket_OpenRxCursor(&s_RINGfd, &s_RING, &s_Cursor, s_RINGPath, s_CursorName);
+	}
+	if (rc < 0)
+	{
+		fprintf(stderr, "failed to open FMAD Ring [%s]\n", s_RINGPath);
+		return 2;
+	}
+
+	// open or create the outputs
+	fFMADRingConfig_t Config;
+	FMADPacket_ConfigDefault(&Config);
+	Config.Version			= RingVersion;
+	Config.IsFlowControl	= IsFlowControl;
+	Config.TimeoutNS		= TxTimeoutNS;
+	Config.Depth			= RingDepth;
+	Config.DataSize			= RingDataSize;
+	Config.Feature			= RingFeature;
+	Config.NUMANode			= FMADPacket_NUMANode(s_RING);
+
+	bool IsMeta = false;
+	for (int o=0; o < s_OutputCnt; o++)
+	{
+		Output_t* O = &s_Output[o];
+		if (FMADPacket_OpenTxConfig(&O->fd, &O->RING, false, O->Path, &Config) < 0)
+		{
+			fprintf(stderr, "failed to open FMAD Ring [%s]\n", O->Path);
+			return 3;
+		}
+		IsMeta |= O->IsMeta;
+	}
+
+	// pin local to the input ring memory
+	CPU = FMADPacket_NUMACPU(s_RING, CPU);
+	if (CPU != -1)
+	{
+		cpu_set_t  mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(CPU, &mask);
+		sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
+	// signal handlers
+	signal(SIGINT,  signal_handler);
+	signal(SIGHUP,  signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	u64 TotalPkt 	= 0;
+	u64 TotalByte 	= 0;
+	u64 TotalTorn	= 0;
+	u64 LastTS		= 0;
+	bool IsEOF		= false;
+
+	bool IsStage	= FMADPacket_IsOverwrite(s_RING);
+
+	while (!s_Exit)
+	{
+		fFMADRingBatch_t Batch;
+
+		// payloads stay in the input slots, or s_Stage, until the outputs have been sent
+		int ret = FMADPacket_RecvBatchCursor(s_RING, s_Cursor, false, &Batch, FMADRING_BATCH_MAX);
+
+		for (int i=0; i < ret; i++)
+		{
+			const fFMADRingPacket_t* Pkt = Batch.Pkt[i];
+			if (IsStage)
+			{
+				if (!InputStage(&Batch, i))
+				{
+					TotalTorn++;
+					continue;
+				}
+				Pkt = &s_Stage[i];
+			}
+
+			// headers are parsed once for all outputs, by the producer when the input carries them
+			fFMADRingMeta_t MetaParse;
+			const fFMADRingMeta_t* Meta = FMADPacket_PacketMeta(s_RING, Pkt);
+			if (IsMeta && (Meta == NULL))
+			{
+				FMADPacket_MetaParse(&MetaParse, Pkt->Payload, Pkt->LengthCapture);
+				Meta = &MetaParse;
+			}
+
+			for (int o=0; o < s_OutputCnt; o++)
+			{
+				Output_t* O = &s_Output[o];
+				if (!OutputMatch(O, Pkt, Meta)) continue;
+
+				fFMADRingSendDesc_t* D = &O->Desc[O->DescCnt++];
+				D->TS				= Pkt->TS;
+				D->LengthWire		= Pkt->LengthWire;
+				D->LengthCapture	= Pkt->LengthCapture;
+				D->Port				= Pkt->Port;
+				D->Flag				= Pkt->Flag;
+				D->StorageID		= Pkt->StorageID;
+				D->Payload			= (void*)Pkt->Payload;
+
+				if ((O->SnapLen != 0) && (D->LengthCapture > O->SnapLen)) D->LengthCapture = O->SnapLen;
+			}
+		}
+
+		if (ret > 0)
+		{
+			// one batch per output, then the input slots can be re-used
+			for (int o=0; o < s_OutputCnt; o++) OutputFlush(&s_Output[o]);
+
+			TotalPkt 	+= Batch.PktCnt;
+			TotalByte 	+= Batch.Byte;
+			LastTS		= Batch.LastTS;
+
+			TotalTorn	+= FMADPacket_RecvBatchReleaseCursor(s_RING, s_Cursor, &Batch);
+		}
+
+		// end of stream
+		if (ret < 0)
+		{
+			IsEOF = true;
+			break;
+		}
+
+		// request is nonblocking, run less hot. sleeps on the rings futex if it has one
+		if (ret == 0)
+		{
+			if (s_NoSleep)
+			{
+				ndelay(100);
+			}
+			else
+			{
+				FMADPacket_RecvSleep(s_RING, s_Cursor, 100e6);
+			}
+		}
+	}
+
+	// readers of the outputs exit
+	if (IsEOF && EnableEOFPacket)
+	{
+		for (int o=0; o < s_OutputCnt; o++) FMADPacket_SendEOFV1(s_Output[o].RING, LastTS);
+	}
+
+	// producer no longer waits for this reader
+	FMADPacket_CursorDetach(s_RING, s_Cursor);
+
+	// summary stats
+	fprintf(stderr, "TotalPkt: %lli TotalByte:%lli TotalTorn:%lli\n", TotalPkt, TotalByte, TotalTorn);
+	for (int o=0; o < s_OutputCnt; o++)
+	{
+		Output_t* O = &s_Output[o];
+		fprintf(stderr, "Output[%-50s] Pkt:%lli Byte:%lli Drop:%lli\n", O->Path, O->PktCnt, O->Byte, O->DropCnt);
+	}
+
+	return 0;
+}
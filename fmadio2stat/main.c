@@ -22,6 +22,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
 
 #include "include/fmadio_packet.h"
 
@@ -58,6 +60,22 @@ static char* FormatTS(u64 ts)
 	return str;
 }
 
+//------------------------------------------------------------------------------
+// print a string as a json string, shared memory contents are not trusted 
+
+static void JSONString(const u8* Str, u32 Max)
+{
+	printf("\"");
+	for (u32 i=0; (i < Max) && (Str[i] != 0); i++)
+	{
+		u8 c = Str[i];
+		if ((c == '"') || (c == '\\'))	printf("\\%c", c);
+		else if (c < 0x20)				printf("\\u%04x", c);
+		else							printf("%c", c);
+	}
+	printf("\"");
+}
+
 //------------------------------------------------------------------------------
 static void help(void)
 {
@@ -113,12 +131,47 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	// what backs the ring mapping
+	const char* PageType = "regular";
+	if (FMADPacket_HugeTLBSize(s_RINGfd) != 0)				PageType = "hugetlbfs";
+	else if (FMADPacket_PageSize(s_RING) > FMADRING_PAGESIZE)	PageType = "transparent huge";
+
 	// human
 	if (!IsJSON)
 	{
 		printf("RING[%-50s] : Upstream: %20lli Bytes   (%10.2f GB)\n", 	s_RING->Path, s_RING->PendingB, s_RING->PendingB / 1e9);
 		printf("RING[%-50s] :                                     \n", 	s_RING->Path);
 
+		printf("RING[%-50s] : Format  : %20s\n", 						s_RING->Path, (s_RING->Version == FMADRING_VERSION2) ? "packed" : "fixed");
+		printf("RING[%-50s] : Depth   : %20lli Slots  (%10.2f MB)\n", 	s_RING->Path, s_RING->Depth, FMADPacket_MapSize(s_RING) / 1e6);
+		printf("RING[%-50s] : PageSize: %20lli Bytes  (%s)\n", 			s_RING->Path, FMADPacket_PageSize(s_RING), PageType);
+		if (FMADPacket_NUMANode(s_RING) != FMADRING_NUMA_NONE)
+		{
+			printf("RING[%-50s] : NUMA    : %20i Node\n", 				s_RING->Path, FMADPacket_NUMANode(s_RING));
+		}
+		printf("RING[%-50s] : Feature : %20x %s%s%s%s%s%s\n", 				s_RING->Path, s_RING->Feature, 
+																			(s_RING->Feature & FMADRING_FEATURE_MPSC) ? "multi-producer " : "",
+																			(s_RING->Feature & FMADRING_FEATURE_FUTEX) ? "futex " : "",
+																			(s_RING->Feature & FMADRING_FEATURE_META) ? "meta " : "",
+																			(s_RING->Feature & FMADRING_FEATURE_LATENCY) ? "latency " : "",
+																			(s_RING->Feature & FMADRING_FEATURE_SEQ) ? "seq " : "",
+																			(s_RING->Feature & FMADRING_FEATURE_NOCACHE) ? "nocache " : "");
+		if (s_RING->Feature & FMADRING_FEATURE_FUTEX)
+		{
+			printf("RING[%-50s] : Sleeping: %20i Readers  %7i Producers\n", s_RING->Path, s_RING->PutWaiter, s_RING->GetWaiter);
+		}
+		if (s_RING->Feature & FMADRING_FEATURE_MPSC)
+		{
+			printf("RING[%-50s] : Reserve : %20lli Pkts   (%lli uncommitted)\n", s_RING->Path, s_RING->PutReserve, s_RING->PutReserve - s_RING->Put);
+		}
+		if (s_RING->Version == FMADRING_VERSION2)
+		{
+			printf("RING[%-50s] : PutPos  : %20lli Bytes  (%10.2f GB)\n", s_RING->Path, s_RING->PutPos, s_RING->PutPos / 1e9);
+			printf("RING[%-50s] : GetPos  : %20lli Bytes  (%10.2f GB)\n", s_RING->Path, s_RING->GetPos, s_RING->GetPos / 1e9);
+			printf("RING[%-50s] :           %20lli of %lli\n", 			s_RING->Path, s_RING->PutPos - s_RING->GetPos, s_RING->DataSize);
+		}
+		printf("RING[%-50s] :                                     \n", 	s_RING->Path);
+
 		printf("RING[%-50s] : Put     : %20lli Pkts   (%10.2f Bn)\n", 	s_RING->Path, s_RING->Put, s_RING->Put / 1e9);
 		printf("RING[%-50s] : Get     : %20lli Pkts   (%10.2f Bn)\n", 	s_RING->Path, s_RING->Get, s_RING->Get / 1e9);
 		printf("RING[%-50s] :           %20lli\n", 						s_RING->Path, s_RING->Put - s_RING->Get);
@@ -126,16 +179,86 @@ int main(int argc, char* argv[])
 		printf("RING[%-50s] : PutByte : %20lli Bytes  (%10.2f GB)\n", 	s_RING->Path, s_RING->PutByte, s_RING->PutByte / 1e9);
 		printf("RING[%-50s] : GetByte : %20lli Bytes  (%10.2f GB)\n", 	s_RING->Path, s_RING->GetByte, s_RING->GetByte / 1e9);
 		printf("RING[%-50s] :           %20lli\n", 						s_RING->Path, s_RING->PutByte - s_RING->GetByte);
+		printf("RING[%-50s] : Drop    : %20lli Pkts  %20lli Bytes\n", 	s_RING->Path, s_RING->PutDropPkt, s_RING->PutDropByte);
 
 		printf("RING[%-50s] : PutTS   : %20lli Epoch  (%s)\n", 			s_RING->Path, s_RING->PutPktTS, FormatTS(s_RING->PutPktTS) );
 		printf("RING[%-50s] : GetTS   : %20lli Epoch  (%s)\n", 			s_RING->Path, s_RING->GetPktTS, FormatTS(s_RING->GetPktTS) );
 		printf("RING[%-50s] :           %20lli\n", 						s_RING->Path, s_RING->PutPktTS - s_RING->GetPktTS);
+
+		// telemetry
+		const char* OccUnit = (s_RING->Version == FMADRING_VERSION2) ? "Bytes" : "Slots";
+		u64 OccSize = (s_RING->Version == FMADRING_VERSION2) ? s_RING->DataSize : s_RING->Depth;
+
+		printf("RING[%-50s] :                                     \n", 	s_RING->Path);
+		printf("RING[%-50s] : PutStall: %20lli Waits  %14.6f sec\n", 	s_RING->Path, s_RING->PutStallCnt, tsc2ns(s_RING->PutStallCycle) / 1e9);
+		printf("RING[%-50s] : GetStall: %20lli Waits  %14.6f sec\n", 	s_RING->Path, s_RING->GetStallCnt, tsc2ns(s_RING->GetStallCycle) / 1e9);
+		printf("RING[%-50s] : Timeout : %20lli\n", 						s_RING->Path, s_RING->PutTimeoutCnt);
+		printf("RING[%-50s] : OccMax  : %20lli %s  (%6.2f %%)\n", 		s_RING->Path, s_RING->PutOccMax, OccUnit, (100.0 * s_RING->PutOccMax) / OccSize);
+
+		// occupancy histogram, only the populated bins
+		u64 OccTotal = 0;
+		for (int i=0; i < FMADRING_STAT_HISTO; i++) OccTotal += s_RING->PutOccHisto[i];
+		for (int i=0; i < FMADRING_STAT_HISTO; i++)
+		{
+			if (s_RING->PutOccHisto[i] == 0) continue;
+
+			u64 Lo = (i == 0) ? 0 : (1ULL << (i - 1));
+			printf("RING[%-50s] :   Occ   : %20lli %s+ %14lli (%6.2f %%)\n", s_RING->Path, Lo, OccUnit, s_RING->PutOccHisto[i], (100.0 * s_RING->PutOccHisto[i]) / OccTotal);
+		}
+
+		// write to receive latency
+		if (s_RING->Feature & FMADRING_FEATURE_LATENCY)
+		{
+			printf("RING[%-50s] :                                     \n", 	s_RING->Path);
+			printf("RING[%-50s] : Latency : %20lli Pkts   %14.3f usec avg\n", s_RING->Path, s_RING->LatCnt, (s_RING->LatCnt == 0) ? 0.0 : (s_RING->LatSum / 1e3) / s_RING->LatCnt);
+			printf("RING[%-50s] :   p50   : %20.3f usec\n", 				s_RING->Path, FMADPacket_LatPercentile(s_RING, 50.0) / 1e3);
+			printf("RING[%-50s] :   p99   : %20.3f usec\n", 				s_RING->Path, FMADPacket_LatPercentile(s_RING, 99.0) / 1e3);
+			printf("RING[%-50s] :   p99.9 : %20.3f usec\n", 				s_RING->Path, FMADPacket_LatPercentile(s_RING, 99.9) / 1e3);
+			printf("RING[%-50s] :   Max   : %20.3f usec\n", 				s_RING->Path, s_RING->LatMax / 1e3);
+
+			// populated bins
+			for (int i=0; i < FMADRING_LAT_HISTO; i++)
+			{
+				if (s_RING->LatHisto[i] == 0) continue;
+				printf("RING[%-50s] :   Lat   : %20.3f usec+ %13lli (%6.2f %%)\n", s_RING->Path, FMADPacket_LatBinNS(i) / 1e3, s_RING->LatHisto[i], (100.0 * s_RING->LatHisto[i]) / s_RING->LatCnt);
+			}
+		}
+
+		// attached and previously attached readers
+		for (int i=0; i < FMADRING_CURSOR_MAX; i++)
+		{
+			fFMADRingCursor_t* C = &s_RING->Cursor[i];
+			bool IsActive = (s_RING->CursorMask >> i) & 1;
+			if (!IsActive && (C->Name[0] == 0)) continue;
+
+			printf("RING[%-50s] :                                     \n", 	s_RING->Path);
+			printf("RING[%-50s] : Reader%2i: %20s %s pid %i\n", 			s_RING->Path, i, (C->Name[0] == 0) ? "default" : (char*)C->Name, IsActive ? "active" : "detached", C->PID);
+			if (C->Flag & FMADRING_CURSOR_FLAG_GROUP)
+			{
+				printf("RING[%-50s] :   Group : %20i Members  %14lli Claimed\n", s_RING->Path, C->Members, C->Claim - C->Get);
+			}
+			printf("RING[%-50s] :   Lag   : %20lli Pkts  %20lli Bytes\n", 	s_RING->Path, s_RING->Put - C->Get, s_RING->PutByte - C->GetByte);
+			printf("RING[%-50s] :   Lost  : %20lli Pkts  %20lli Bytes\n", 	s_RING->Path, C->LostPkt, C->LostByte);
+		}
 	}
 	else
 	{
 		printf("{\"ring\":\"%s\",", s_RING->Path);
 
 		printf("\"UpstreamByte\":%lli,", s_RING->PendingB);
+		printf("\"Version\":%i,", s_RING->Version);
+		printf("\"PutPos\":%lli,", s_RING->PutPos);
+		printf("\"GetPos\":%lli,", s_RING->GetPos);
+		printf("\"DataSize\":%lli,", s_RING->DataSize);
+		printf("\"Depth\":%lli,", s_RING->Depth);
+		printf("\"MapSize\":%lli,", FMADPacket_MapSize(s_RING));
+		printf("\"PageSize\":%lli,", FMADPacket_PageSize(s_RING));
+		printf("\"PageType\":\"%s\",", PageType);
+		printf("\"NUMANode\":%i,", FMADPacket_NUMANode(s_RING));
+		printf("\"Feature\":%i,", s_RING->Feature);
+		printf("\"PutReserve\":%lli,", s_RING->PutReserve);
+		printf("\"PutWaiter\":%i,", s_RING->PutWaiter);
+		printf("\"GetWaiter\":%i,", s_RING->GetWaiter);
 		printf("\"Put\":%lli,", s_RING->Put);
 		printf("\"Get\":%lli,", s_RING->Get);
 		printf("\"dPutGet\":%lli,", s_RING->Put - s_RING->Get);
@@ -143,11 +266,50 @@ int main(int argc, char* argv[])
 		printf("\"PutByte\":%lli,", s_RING->PutByte);
 		printf("\"GetByte\":%lli,", s_RING->GetByte);
 		printf("\"dByte\":%lli,", s_RING->PutByte - s_RING->GetByte);
+		printf("\"PutDropPkt\":%lli,", s_RING->PutDropPkt);
+		printf("\"PutDropByte\":%lli,", s_RING->PutDropByte);
 
 		printf("\"PutPktTS\":%lli,", s_RING->PutPktTS);
 		printf("\"GetPktTS\":%lli,", s_RING->GetPktTS);
 		printf("\"dPktTS\":%lli,", s_RING->PutPktTS - s_RING->GetPktTS);
 
+		printf("\"PutStallCnt\":%lli,", s_RING->PutStallCnt);
+		printf("\"PutStallNS\":%lli,", tsc2ns(s_RING->PutStallCycle));
+		printf("\"GetStallCnt\":%lli,", s_RING->GetStallCnt);
+		printf("\"GetStallNS\":%lli,", tsc2ns(s_RING->GetStallCycle));
+		printf("\"PutTimeoutCnt\":%lli,", s_RING->PutTimeoutCnt);
+		printf("\"OccMax\":%lli,", s_RING->PutOccMax);
+		printf("\"OccHisto\":[");
+		for (int i=0; i < FMADRING_STAT_HISTO; i++) printf("%s%lli", (i == 0) ? "" : ",", s_RING->PutOccHisto[i]);
+		printf("],");
+		printf("\"LatCnt\":%lli,", s_RING->LatCnt);
+		printf("\"LatSumNS\":%lli,", s_RING->LatSum);
+		printf("\"LatMaxNS\":%lli,", s_RING->LatMax);
+		printf("\"LatP50NS\":%lli,", FMADPacket_LatPercentile(s_RING, 50.0));
+		printf("\"LatP99NS\":%lli,", FMADPacket_LatPercentile(s_RING, 99.0));
+		printf("\"LatP999NS\":%lli,", FMADPacket_LatPercentile(s_RING, 99.9));
+		printf("\"LatHisto\":[");
+		for (int i=0; i < FMADRING_LAT_HISTO; i++) printf("%s%lli", (i == 0) ? "" : ",", s_RING->LatHisto[i]);
+		printf("],");
+
+		printf("\"Readers\":[");
+		bool IsFirst = true;
+		for (int i=0; i < FMADRING_CURSOR_MAX; i++)
+		{
+			fFMADRingCursor_t* C = &s_RING->Cursor[i];
+			bool IsActive = (s_RING->CursorMask >> i) & 1;
+			if (!IsActive && (C->Name[0] == 0)) continue;
+
+			printf("%s{\"Index\":%i,\"Name\":", IsFirst ? "" : ",", i);
+			JSONString((C->Name[0] == 0) ? (u8*)"default" : C->Name, sizeof(C->Name));
+			printf(",\"Active\":%i,\"PID\":%i,", IsActive, C->PID);
+			printf("\"Members\":%i,\"Claimed\":%lli,", (C->Flag & FMADRING_CURSOR_FLAG_GROUP) ? C->Members : 0, (C->Flag & FMADRING_CURSOR_FLAG_GROUP) ? C->Claim - C->Get : 0);
+			printf("\"Get\":%lli,\"GetByte\":%lli,\"dPutGet\":%lli,\"dByte\":%lli,", C->Get, C->GetByte, s_RING->Put - C->Get, s_RING->PutByte - C->GetByte);
+			printf("\"LostPkt\":%lli,\"LostByte\":%lli}", C->LostPkt, C->LostByte);
+			IsFirst = false;
+		}
+		printf("],");
+
 
 		printf("\"zero\":0}\n");
 	}
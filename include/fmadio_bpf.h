@@ -0,0 +1,464 @@
+//------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// classic BPF packet filter run directly against the ring slot payload. programs are checked
+// once when loaded so the interpreter runs without jump or memory index checks, only packet
+// loads are bounds checked against the captured length
+//
+// filters are tcpdump expressions compiled by libpcap when built with WITH_PCAP (-lpcap),
+// otherwise the compiled program as printed by tcpdump -ddd, comma or whitespace separated,
+// or @<file> holding it
+//
+//	tcpdump -ddd 'tcp port 80' > web.bpf
+//	fmadio2pcap -i /opt/fmadio/queue/lxc_ring0 --bpf @web.bpf
+//
+// expects the u8..u64 types, included after fmadio_packet.h
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#ifndef  __FMADIO_BPF_H__
+#define  __FMADIO_BPF_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WITH_PCAP
+#include <pcap/pcap.h>
+#endif
+
+//---------------------------------------------------------------------------------------------
+
+#define FMADBPF_INSN_MAX			4096			// BPF_MAXINSNS
+#define FMADBPF_MEM_MAX				16				// scratch memory words
+#define FMADBPF_TEXT_MAX			(256*1024)		// largest @file
+
+// instruction classes
+#define FMADBPF_LD					0x00
+#define FMADBPF_LDX					0x01
+#define FMADBPF_ST					0x02
+#define FMADBPF_STX					0x03
+#define FMADBPF_ALU					0x04
+#define FMADBPF_JMP					0x05
+#define FMADBPF_RET					0x06
+#define FMADBPF_MISC				0x07
+
+// load size / mode
+#define FMADBPF_W					0x00
+#define FMADBPF_H					0x08
+#define FMADBPF_B					0x10
+#define FMADBPF_IMM					0x00
+#define FMADBPF_ABS					0x20
+#define FMADBPF_IND					0x40
+#define FMADBPF_MEM					0x60
+#define FMADBPF_LEN					0x80
+#define FMADBPF_MSH					0xa0
+
+// alu / jump operations and operand
+#define FMADBPF_ADD					0x00
+#define FMADBPF_SUB					0x10
+#define FMADBPF_MUL					0x20
+#define FMADBPF_DIV					0x30
+#define FMADBPF_OR					0x40
+#define FMADBPF_AND					0x50
+#define FMADBPF_LSH					0x60
+#define FMADBPF_RSH					0x70
+#define FMADBPF_NEG					0x80
+#define FMADBPF_MOD					0x90
+#define FMADBPF_XOR					0xa0
+
+#define FMADBPF_JA					0x00
+#define FMADBPF_JEQ					0x10
+#define FMADBPF_JGT					0x20
+#define FMADBPF_JGE					0x30
+#define FMADBPF_JSET				0x40
+
+#define FMADBPF_K					0x00
+#define FMADBPF_X					0x08
+#define FMADBPF_A					0x10			// RET A
+
+#define FMADBPF_TAX					0x00
+#define FMADBPF_TXA					0x80
+
+// same layout as struct bpf_insn
+typedef struct fFMADBPFInsn_t
+{
+	u16				Code;
+	u8				JT;								// relative jump if true
+	u8				JF;								// relative jump if false
+	u32				K;
+
+} fFMADBPFInsn_t;
+
+typedef struct fFMADBPF_t
+{
+	u32				InsnCnt;
+	fFMADBPFInsn_t	Insn[FMADBPF_INSN_MAX];
+
+} fFMADBPF_t;
+
+//---------------------------------------------------------------------------------------------
+// accept only programs the interpreter can run without runtime checks. every jump lands
+// inside the program, scratch memory indexes are in range, no constant divide by zero and
+// the last instruction returns
+static inline int FMADBPF_Check(const fFMADBPF_t* BPF)
+{
+	if ((BPF->InsnCnt == 0) || (BPF->InsnCnt > FMADBPF_INSN_MAX))
+	{
+		fprintf(stderr, "BPF ERROR invalid instruction count %i\n", BPF->InsnCnt);
+		return -1;
+	}
+
+	for (u32 pc=0; pc < BPF->InsnCnt; pc++)
+	{
+		const fFMADBPFInsn_t* I = &BPF->Insn[pc];
+		bool IsValid = true;
+
+		switch (I->Code)
+		{
+		case FMADBPF_LD  | FMADBPF_W | FMADBPF_ABS:
+		case FMADBPF_LD  | FMADBPF_H | FMADBPF_ABS:
+		case FMADBPF_LD  | FMADBPF_B | FMADBPF_ABS:
+		case FMADBPF_LD  | FMADBPF_W | FMADBPF_IND:
+		case FMADBPF_LD  | FMADBPF_H | FMADBPF_IND:
+		case FMADBPF_LD  | FMADBPF_B | FMADBPF_IND:
+		case FMADBPF_LD  | FMADBPF_W | FMADBPF_LEN:
+		case FMADBPF_LD  | FMADBPF_IMM:
+		case FMADBPF_LDX | FMADBPF_W | FMADBPF_IMM:
+		case FMADBPF_LDX | FMADBPF_W | FMADBPF_LEN:
+		case FMADBPF_LDX | FMADBPF_B | FMADBPF_MSH:
+		case FMADBPF_RET | FMADBPF_K:
+		case FMADBPF_RET | FMADBPF_A:
+		case FMADBPF_MISC| FMADBPF_TAX:
+		case FMADBPF_MISC| FMADBPF_TXA:
+			break;
+
+		// scratch memory
+		case FMADBPF_LD  | FMADBPF_MEM:
+		case FMADBPF_LDX | FMADBPF_MEM:
+		case FMADBPF_ST:
+		case FMADBPF_STX:
+			IsValid = (I->K < FMADBPF_MEM_MAX);
+			break;
+
+		case FMADBPF_ALU | FMADBPF_DIV | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_MOD | FMADBPF_K:
+			IsValid = (I->K != 0);
+			break;
+
+		case FMADBPF_ALU | FMADBPF_ADD | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_SUB | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_MUL | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_OR  | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_AND | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_LSH | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_RSH | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_XOR | FMADBPF_K:
+		case FMADBPF_ALU | FMADBPF_ADD | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_SUB | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_MUL | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_DIV | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_MOD | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_OR  | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_AND | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_LSH | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_RSH | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_XOR | FMADBPF_X:
+		case FMADBPF_ALU | FMADBPF_NEG:
+			break;
+
+		// forward only, target inside the program
+		case FMADBPF_JMP | FMADBPF_JA:
+			IsValid = ((u64)pc + 1 + I->K < BPF->InsnCnt);
+			break;
+
+		case FMADBPF_JMP | FMADBPF_JEQ  | FMADBPF_K:
+		case FMADBPF_JMP | FMADBPF_JGT  | FMADBPF_K:
+		case FMADBPF_JMP | FMADBPF_JGE  | FMADBPF_K:
+		case FMADBPF_JMP | FMADBPF_JSET | FMADBPF_K:
+		case FMADBPF_JMP | FMADBPF_JEQ  | FMADBPF_X:
+		case FMADBPF_JMP | FMADBPF_JGT  | FMADBPF_X:
+		case FMADBPF_JMP | FMADBPF_JGE  | FMADBPF_X:
+		case FMADBPF_JMP | FMADBPF_JSET | FMADBPF_X:
+			IsValid = (pc + 1 + I->JT < BPF->InsnCnt) && (pc + 1 + I->JF < BPF->InsnCnt);
+			break;
+
+		default:
+			IsValid = false;
+			break;
+		}
+
+		if (!IsValid)
+		{
+			fprintf(stderr, "BPF ERROR invalid instruction %i code:0x%04x jt:%i jf:%i k:0x%08x\n", pc, I->Code, I->JT, I->JF, I->K);
+			return -1;
+		}
+	}
+
+	u16 Last = BPF->Insn[BPF->InsnCnt - 1].Code;
+	if ((Last & 0x07) != FMADBPF_RET)
+	{
+		fprintf(stderr, "BPF ERROR program does not end with a return\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// run a checked program over a packet. returns the filters snap length, 0 to drop
+static inline u32 FMADBPF_Run(const fFMADBPF_t* BPF, const u8* Pkt, u32 LengthWire, u32 LengthCapture)
+{
+	const fFMADBPFInsn_t* I = BPF->Insn;
+
+	u32 A = 0;
+	u32 X = 0;
+	u32 M[FMADBPF_MEM_MAX] = { 0 };		// scratch memory reads as zero until stored, same as libpcap
+	u64 Off;							// X + K can wrap 32 bits, compared against the length in 64
+
+	while (true)
+	{
+		switch (I->Code)
+		{
+		// packet loads, out of bounds drops the packet
+		case FMADBPF_LD | FMADBPF_W | FMADBPF_ABS:
+			Off = I->K;
+		load_w:
+			if (Off + 4 > LengthCapture) return 0;
+			A = ((u32)Pkt[Off] << 24) | ((u32)Pkt[Off + 1] << 16) | ((u32)Pkt[Off + 2] << 8) | Pkt[Off + 3];
+			break;
+
+		case FMADBPF_LD | FMADBPF_H | FMADBPF_ABS:
+			Off = I->K;
+		load_h:
+			if (Off + 2 > LengthCapture) return 0;
+			A = ((u32)Pkt[Off] << 8) | Pkt[Off + 1];
+			break;
+
+		case FMADBPF_LD | FMADBPF_B | FMADBPF_ABS:
+			Off = I->K;
+		load_b:
+			if (Off >= LengthCapture) return 0;
+			A = Pkt[Off];
+			break;
+
+		case FMADBPF_LD | FMADBPF_W | FMADBPF_IND:	Off = (u64)X + I->K; goto load_w;
+		case FMADBPF_LD | FMADBPF_H | FMADBPF_IND:	Off = (u64)X + I->K; goto load_h;
+		case FMADBPF_LD | FMADBPF_B | FMADBPF_IND:	Off = (u64)X + I->K; goto load_b;
+
+		// 4 * IP header length
+		case FMADBPF_LDX | FMADBPF_B | FMADBPF_MSH:
+			if (I->K >= LengthCapture) return 0;
+			X = (Pkt[I->K] & 0xf) << 2;
+			break;
+
+		case FMADBPF_LD  | FMADBPF_W | FMADBPF_LEN:	A = LengthWire;			break;
+		case FMADBPF_LDX | FMADBPF_W | FMADBPF_LEN:	X = LengthWire;			break;
+		case FMADBPF_LD  | FMADBPF_IMM:				A = I->K;				break;
+		case FMADBPF_LDX | FMADBPF_W | FMADBPF_IMM:	X = I->K;				break;
+		case FMADBPF_LD  | FMADBPF_MEM:				A = M[I->K];			break;
+		case FMADBPF_LDX | FMADBPF_MEM:				X = M[I->K];			break;
+		case FMADBPF_ST:							M[I->K] = A;			break;
+		case FMADBPF_STX:							M[I->K] = X;			break;
+
+		case FMADBPF_ALU | FMADBPF_ADD | FMADBPF_K:	A += I->K;				break;
+		case FMADBPF_ALU | FMADBPF_SUB | FMADBPF_K:	A -= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_MUL | FMADBPF_K:	A *= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_DIV | FMADBPF_K:	A /= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_MOD | FMADBPF_K:	A %= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_OR  | FMADBPF_K:	A |= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_AND | FMADBPF_K:	A &= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_XOR | FMADBPF_K:	A ^= I->K;				break;
+		case FMADBPF_ALU | FMADBPF_LSH | FMADBPF_K:	A = (I->K < 32) ? A << I->K : 0; break;
+		case FMADBPF_ALU | FMADBPF_RSH | FMADBPF_K:	A = (I->K < 32) ? A >> I->K : 0; break;
+
+		case FMADBPF_ALU | FMADBPF_ADD | FMADBPF_X:	A += X;					break;
+		case FMADBPF_ALU | FMADBPF_SUB | FMADBPF_X:	A -= X;					break;
+		case FMADBPF_ALU | FMADBPF_MUL | FMADBPF_X:	A *= X;					break;
+		case FMADBPF_ALU | FMADBPF_DIV | FMADBPF_X:	if (X == 0) return 0; A /= X; break;
+		case FMADBPF_ALU | FMADBPF_MOD | FMADBPF_X:	if (X == 0) return 0; A %= X; break;
+		case FMADBPF_ALU | FMADBPF_OR  | FMADBPF_X:	A |= X;					break;
+		case FMADBPF_ALU | FMADBPF_AND | FMADBPF_X:	A &= X;					break;
+		case FMADBPF_ALU | FMADBPF_XOR | FMADBPF_X:	A ^= X;					break;
+		case FMADBPF_ALU | FMADBPF_LSH | FMADBPF_X:	A = (X < 32) ? A << X : 0; break;
+		case FMADBPF_ALU | FMADBPF_RSH | FMADBPF_X:	A = (X < 32) ? A >> X : 0; break;
+		case FMADBPF_ALU | FMADBPF_NEG:				A = -A;					break;
+
+		case FMADBPF_JMP | FMADBPF_JA:				I += I->K;				break;
+		case FMADBPF_JMP | FMADBPF_JEQ  | FMADBPF_K:	I += (A == I->K)		? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JGT  | FMADBPF_K:	I += (A >  I->K)		? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JGE  | FMADBPF_K:	I += (A >= I->K)		? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JSET | FMADBPF_K:	I += (A & I->K)			? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JEQ  | FMADBPF_X:	I += (A == X)			? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JGT  | FMADBPF_X:	I += (A >  X)			? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JGE  | FMADBPF_X:	I += (A >= X)			? I->JT : I->JF; break;
+		case FMADBPF_JMP | FMADBPF_JSET | FMADBPF_X:	I += (A & X)			? I->JT : I->JF; break;
+
+		case FMADBPF_RET | FMADBPF_K:				return I->K;
+		case FMADBPF_RET | FMADBPF_A:				return A;
+
+		case FMADBPF_MISC | FMADBPF_TAX:			X = A;					break;
+		case FMADBPF_MISC | FMADBPF_TXA:			A = X;					break;
+
+		// not reached on a checked program
+		default:									return 0;
+		}
+		I++;
+	}
+}
+
+// filter a ring slot in place
+static inline bool FMADBPF_Packet(const fFMADBPF_t* BPF, const fFMADRingPacket_t* Pkt)
+{
+	return FMADBPF_Run(BPF, Pkt->Payload, Pkt->LengthWire, Pkt->LengthCapture) != 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// tcpdump -ddd output, instruction count then code jt jf k per instruction
+static inline int FMADBPF_Parse(fFMADBPF_t* BPF, const char* Text)
+{
+	const char* p = Text;
+	char* End = NULL;
+
+	u64 Value[4];
+	u32 ValueCnt = 0;
+	s64 InsnCnt = -1;
+
+	BPF->InsnCnt = 0;
+	while (true)
+	{
+		while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r') || (*p == ',')) p++;
+		if (*p == 0) break;
+
+		u64 v = strtoull(p, &End, 0);
+		if (End == p)
+		{
+			fprintf(stderr, "BPF ERROR expected a number at [%.16s]\n", p);
+			return -1;
+		}
+		p = End;
+
+		if (InsnCnt < 0)
+		{
+			InsnCnt = v;
+			if ((InsnCnt == 0) || (InsnCnt > FMADBPF_INSN_MAX))
+			{
+				fprintf(stderr, "BPF ERROR invalid instruction count %lli\n", InsnCnt);
+				return -1;
+			}
+			continue;
+		}
+
+		Value[ValueCnt++] = v;
+		if (ValueCnt < 4) continue;
+
+		if (BPF->InsnCnt >= InsnCnt)
+		{
+			fprintf(stderr, "BPF ERROR more than %lli instructions\n", InsnCnt);
+			return -1;
+		}
+
+		fFMADBPFInsn_t* I = &BPF->Insn[BPF->InsnCnt++];
+		I->Code		= Value[0];
+		I->JT		= Value[1];
+		I->JF		= Value[2];
+		I->K		= Value[3];
+		ValueCnt	= 0;
+	}
+
+	if ((InsnCnt < 0) || (BPF->InsnCnt != InsnCnt) || (ValueCnt != 0))
+	{
+		fprintf(stderr, "BPF ERROR expected %lli instructions got %i\n", InsnCnt, BPF->InsnCnt);
+		return -1;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// compile a filter for ethernet frames. Expr is a tcpdump expression (WITH_PCAP), a
+// tcpdump -ddd program or @<file> with the program. returns NULL on error
+static inline fFMADBPF_t* FMADBPF_Compile(const char* Expr)
+{
+	fFMADBPF_t* BPF = (fFMADBPF_t*)malloc(sizeof(fFMADBPF_t));
+	if (BPF == NULL) return NULL;
+	memset(BPF, 0, sizeof(fFMADBPF_t));
+
+	int Result = -1;
+
+	// compiled program in a file
+	if (Expr[0] == '@')
+	{
+		FILE* F = fopen(Expr + 1, "r");
+		if (F == NULL)
+		{
+			fprintf(stderr, "BPF ERROR failed to open [%s]\n", Expr + 1);
+			free(BPF);
+			return NULL;
+		}
+
+		char* Text = (char*)malloc(FMADBPF_TEXT_MAX);
+		size_t Len = fread(Text, 1, FMADBPF_TEXT_MAX - 1, F);
+		Text[Len] = 0;
+		fclose(F);
+
+		Result = FMADBPF_Parse(BPF, Text);
+		free(Text);
+	}
+	// compiled program inline
+	else if ((Expr[0] >= '0') && (Expr[0] <= '9') && (strspn(Expr, "0123456789xXabcdefABCDEF ,\t\r\n") == strlen(Expr)))
+	{
+		Result = FMADBPF_Parse(BPF, Expr);
+	}
+	else
+	{
+#ifdef WITH_PCAP
+		pcap_t* Pcap = pcap_open_dead(DLT_EN10MB, 65535);
+
+		struct bpf_program Prog;
+		if (pcap_compile(Pcap, &Prog, Expr, 1, PCAP_NETMASK_UNKNOWN) < 0)
+		{
+			fprintf(stderr, "BPF ERROR [%s] %s\n", Expr, pcap_geterr(Pcap));
+		}
+		else if (Prog.bf_len > FMADBPF_INSN_MAX)
+		{
+			fprintf(stderr, "BPF ERROR [%s] %i instructions too long\n", Expr, Prog.bf_len);
+			pcap_freecode(&Prog);
+		}
+		else
+		{
+			BPF->InsnCnt = Prog.bf_len;
+			for (u32 i=0; i < Prog.bf_len; i++)
+			{
+				BPF->Insn[i].Code	= Prog.bf_insns[i].code;
+				BPF->Insn[i].JT		= Prog.bf_insns[i].jt;
+				BPF->Insn[i].JF		= Prog.bf_insns[i].jf;
+				BPF->Insn[i].K		= Prog.bf_insns[i].k;
+			}
+			pcap_freecode(&Prog);
+			Result = 0;
+		}
+		pcap_close(Pcap);
+#else
+		fprintf(stderr, "BPF ERROR [%s] built without libpcap (make WITH_PCAP=1), pass the output of tcpdump -ddd '<filter>' instead\n", Expr);
+#endif
+	}
+
+	if ((Result < 0) || (FMADBPF_Check(BPF) < 0))
+	{
+		free(BPF);
+		return NULL;
+	}
+
+	fprintf(stderr, "BPF [%s] %i instructions\n", Expr, BPF->InsnCnt);
+	return BPF;
+}
+
+static inline void FMADBPF_Free(fFMADBPF_t* BPF)
+{
+	free(BPF);
+}
+
+#endif
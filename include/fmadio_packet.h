@@ -36,14 +36,6 @@ typedef long long			s64;
 
 //---------------------------------------------------------------------------------------------
 
-static inline volatile u64 rdtsc(void)
-{
-	u32 hi, lo;
-	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi) );
-	return (((u64)hi)<<32ULL) | (u64)lo;
-}
-
-
 static inline void sfence(void)
 {
 	__asm__ volatile("sfence");
@@ -59,41 +51,89 @@ static inline void lfence(void)
 	__asm__ volatile("lfence");
 }
 
-// not great but dont need to calibrate or have any external dependencies
-static inline u64 ns2tsc(u64 ns)
-{
-	return ns * 2;		// assume a 2Ghz cpu
-}
-static inline u64 tsc2ns(u64 tsc)
-{
-	return tsc / 2;		// assume a 2Ghz cpu
-}
-
-
-static void ndelay(u64 ns)
-{
-	u64 NextTS = rdtsc() + ns2tsc(ns);
-	while (rdtsc() < NextTS)
-	{
-		__asm__ volatile("pause");
-		__asm__ volatile("pause");
-		__asm__ volatile("pause");
-		__asm__ volatile("pause");
-	}
-}
+#include "fmadio_time.h"
 
 #endif
 
 //---------------------------------------------------------------------------------------------
 
 #define FMADRING_VERSION		0x00000100			// ring version 
-#define FMADRING_MAPSIZE		(16*1024*1024)		// total size of the map file. deliberately larger than the structure size
+#define FMADRING_VERSION2		0x00000200			// packed variable length ring version
+#define FMADRING_MAPSIZE		(16*1024*1024)		// legacy map size, rings are now mapped using MapSize from the header
 #define FMADRING_ENTRYSIZE		(10*1024)			// total size header and payload of each packet 
-#define FMADRING_ENTRYCNT		(1*1024)			// number of entries in the ring 
+#define FMADRING_ENTRYCNT		(1*1024)			// default number of entries in the ring 
+#define FMADRING_BATCH_MAX		64					// max packets per batched send/recv
 
 #define FMADRING_FLAG_EOF		(1<<0)				// end of file exit
 #define FMADRING_FLAG_FCSERR	(1<<1)				// packet has an FCS error 
 
+#define FMADRING_PACKED_DATASIZE	(8*1024*1024)	// default byte ring size of a packed ring
+#define FMADRING_PACKED_ALIGN		64				// packed records are cache line aligned 
+#define FMADRING_PACKET_HDRSIZE		24				// bytes of fFMADRingPacket_t before the Payload
+
+#define FMADRING_RECORD_FLAG_WRAP	(1<<0)			// packed padding record, continue at the start of the ring
+
+#define FMADRING_PAGESIZE			(4*1024)		// regular page size
+#define FMADRING_HUGEPAGE_2MB		(2*1024*1024)	// largest page transparent huge pages back tmpfs with
+#define FMADRING_HUGEPAGE_1GB		(1024*1024*1024)// needs a hugetlbfs mount
+#define FMADRING_HUGETLBFS_MAGIC	0x958458f6		// statfs f_type of a hugetlbfs mount
+#define FMADRING_TMPFS_MAGIC		0x01021994		// statfs f_type of a tmpfs mount (/dev/shm)
+
+#define FMADRING_CURSOR_MAX			32				// reader cursors on the Get page. 0 is the default reader
+#define FMADRING_CURSOR_FLAG_ACTIVE	(1<<0)			// reader attached, producer flow control waits for it
+#define FMADRING_CURSOR_FLAG_CLAIM	(1<<1)			// reader is attaching
+#define FMADRING_CURSOR_FLAG_GROUP	(1<<2)			// work-sharing group, members claim packets from the cursor
+
+#define FMADRING_FEATURE_MPSC		(1<<0)			// multiple producers reserve slots and commit them with the slot Seq
+#define FMADRING_FEATURE_FUTEX		(1<<1)			// idle readers and a blocked producer sleep on a futex 
+#define FMADRING_FEATURE_META		(1<<2)			// producer parses each packet once and stores fFMADRingMeta_t with it
+#define FMADRING_FEATURE_LATENCY	(1<<3)			// producer stamps each packet with its TSC, readers histogram the ring latency
+#define FMADRING_FEATURE_SEQ		(1<<4)			// producer without flow control stamps each slot Seq/SeqByte, readers detect being lapped
+#define FMADRING_FEATURE_NOCACHE	(1<<5)			// producer and readers re-read the remote Get/Put every check, no GetCache/PutCache (benchmark baseline)
+
+#define FMADRING_OVERRUN_RETRY		64				// attempts to re-sync a lapped reader before giving up until the next call
+#define FMADRING_RESUME_TIMEOUT		1000000000		// longest a resuming reader waits for a producer refresh in flight
+#define FMADRING_GROUP_TIMEOUT		10000000000ULL	// longest a group member waits on earlier claims that make no progress
+
+#define FMADRING_FUTEX_WAIT			0				// FUTEX_WAIT, shared between processes
+#define FMADRING_FUTEX_WAKE			1				// FUTEX_WAKE
+#define FMADRING_FUTEX_TIMEOUT		1000000			// producer re-checks the ring and its timeout every 1msec
+
+#define FMADRING_STAT_HISTO			32				// log2 occupancy histogram bins
+#define FMADRING_STAT_SAMPLE		64				// occupancy is sampled once every 64 packets
+#define FMADRING_LAT_SUBBIT			2				// latency histogram linear sub bins per power of 2, as bits
+#define FMADRING_LAT_SUB			(1<<FMADRING_LAT_SUBBIT)
+#define FMADRING_LAT_HISTO			160				// latency histogram bins, up to ~30 minutes
+
+#define FMADRING_SET_MAX			64				// max rings in a flow hashed ring set
+
+#define FMADRING_NUMA_NONE			-1				// ring memory lands on the node of the first touch
+#define FMADRING_NUMA_MAX			64				// NUMA nodes supported
+#define FMADRING_CPU_AUTO			-2				// pin to a cpu local to the rings NUMA node
+#define FMADRING_MPOL_BIND			2				// MPOL_BIND, numaif.h is not always installed
+#define FMADRING_MPOL_MF_MOVE		(1<<1)			// MPOL_MF_MOVE
+#define FMADRING_NUMA_CHECK			64				// pages sampled to check where a bound ring landed
+
+#define FMADRING_META_VALID			(1<<0)			// ethernet header parsed, offsets below are set
+#define FMADRING_META_FRAG			(1<<1)			// IP fragment, the flow hash excludes the ports
+#define FMADRING_META_TRUNC			(1<<2)			// headers run past the captured bytes
+
+// packet metadata filled in once by the producer (FMADRING_FEATURE_META). offsets are 
+// from the start of the payload, the L2 header is always at 0. an offset of 0 means not present
+typedef struct fFMADRingMeta_t
+{
+	u32				FlowHash;						// symmetric flow hash, same as FMADPacket_FlowHash
+	u16				EtherType;						// ethertype after vlan/mpls tags
+	u16				L3Offset;						// network header 
+	u16				L4Offset;						// transport header 
+	u16				L7Offset;						// transport payload (TCP/UDP/SCTP)
+	u8				IPProto;						// IPv4 protocol or IPv6 next header
+	u8				VLANCnt;						// vlan/qinq tags skipped
+	u8				MPLSCnt;						// mpls labels skipped
+	u8				Flag;							// FMADRING_META_*
+
+} __attribute__((packed)) fFMADRingMeta_t;
+
 typedef struct fFMADRingPacket_t
 {
 	u64				TS;								// 64b nanosecond epoch	
@@ -109,14 +149,80 @@ typedef struct fFMADRingPacket_t
 
 	u8				Payload[FMADRING_ENTRYSIZE];	// payload ensure each entry is 10KB
 
-	u8				padAlign[2024];					// keep it 4KB page aligned	
+	volatile s64	Seq;							// ring index + 1 of the packet in the slot, written last (FMADRING_FEATURE_MPSC or no flow control)
+	volatile u64	SeqByte;						// PutByte before this packet (no flow control)
+	fFMADRingMeta_t	Meta;							// parsed headers (FMADRING_FEATURE_META)
+	volatile u64	PutTSC;							// producer TSC when written (FMADRING_FEATURE_LATENCY)
+	u8				padAlign[2024-2*8-16-8];		// keep it 4KB page aligned	
 
 } __attribute__((packed)) fFMADRingPacket_t;
 
+// FMADRING_VERSION2 packed ring record header. the fFMADRingPacket_t header (TS .. StorageID)
+// follows immediately then LengthCapture bytes of payload. the payload starts on a 
+// FMADRING_PACKED_ALIGN boundary and the record is padded to the next boundary 
+typedef struct fFMADRingRecord_t
+{
+	u32				Size;							// total size of the record including all headers 
+	u32				Flag;							// record flags
+	fFMADRingMeta_t	Meta;							// parsed headers (FMADRING_FEATURE_META)
+	u64				PutTSC;							// producer TSC when written (FMADRING_FEATURE_LATENCY)
+	u8				pad[32-16-8];					// reserved
+
+} __attribute__((packed)) fFMADRingRecord_t;
+
+// descriptors for a batch of received packets 
+typedef struct fFMADRingBatch_t
+{
+	u32						PktCnt;						// number of packets in the batch
+	u64						Byte;						// total capture bytes of the batch
+	u64						LastTS;						// pcap timestamp of the last packet
+	u64						RecordByte;					// ring bytes used by the batch (FMADRING_VERSION2)
+	s64						Claim;						// first slot claimed (work-sharing group)
+	u32						CheckCnt;					// packets checked intact by the reader so far (FMADRING_FEATURE_SEQ)
+
+	const fFMADRingPacket_t* Pkt[FMADRING_BATCH_MAX];	// pointers to the ring slots
+	u16						Length[FMADRING_BATCH_MAX];	// capture length of each packet when received
+
+} fFMADRingBatch_t;
+
+// descriptor for a single packet of a batched send
+typedef struct fFMADRingSendDesc_t
+{
+	u64				TS;								// 64b nanosecond epoch	
+	u32				LengthWire;						// packet length on the wire
+	u32				LengthCapture;					// packet length capture 
+	u32				Port;							// capture port 
+	u32				Flag;							// various flags
+	u64				StorageID;						// Storage ID
+	const void*		Payload;						// packet payload, copied into the ring
+
+} fFMADRingSendDesc_t;
+
+// reader position. each reader owns one, the producer only reads it 
+typedef struct fFMADRingCursor_t
+{
+	volatile s64	Get;							// read pointer	(not maseked)
+	volatile u64	GetByte;						// read total bytes 
+	volatile u64	GetPktTS;						// pcap tiemstamp of last read packet 
+	volatile s64	GetPos;							// byte ring read offset (not masked, FMADRING_VERSION2)
+	volatile s64	Claim;							// next slot to hand out (work-sharing group)
+	s64				PutCache;						// readers copy of Put, only refreshed once its caught up
+	s64				PutPosCache;					// readers copy of PutPos (FMADRING_VERSION2)
+	u8				align0[64-7*8];					// read position on its own cache line
+
+	volatile u64	LostPkt;						// packets overwritten before this reader got to them (no flow control)
+	volatile u64	LostByte;						// bytes overwritten before this reader got to them
+	volatile u32	Flag;							// FMADRING_CURSOR_FLAG_*
+	volatile u32	PID;							// process attached to the cursor
+	volatile u32	Members;						// workers attached (work-sharing group)
+	u8				Name[36];						// reader name, empty for the default reader
+
+} __attribute__((packed)) fFMADRingCursor_t;
+
 typedef struct fFMADRingHeader_t
 {
 	u32				Version;						// FMADRing version
-	u32				Size;							// size of entire structure 
+	u32				Size;							// size of entire structure (saturates at 4GB, see MapSize)
 	u32				SizePacket;						// size of a packet 
 
 	u8				Path[128];						// path of ring
@@ -129,346 +235,2415 @@ typedef struct fFMADRingHeader_t
 
 	u64				PendingB;						// number of bytes pending (on the Put side)
 
-	u8				align0[4096-4*4-4*8-128];		// keep header/put/get all on seperate 4K pages
-
-	//--------------------------------------------------------------------------------	
-	
-	volatile s64	Put;							// write pointer (not maseked)
-	volatile u64	PutByte;						// total number of bytes 
-	volatile u64	PutPktTS;						// pcap timestamp of last put packet 
-	u8				align1[4096-3*8];				// keep header/put/get all on seperate 4K pages
-
-	//--------------------------------------------------------------------------------	
+	u64				DataSize;						// size of the byte ring (FMADRING_VERSION2)
+	u64				DataMask;						// byte ring offset mask (FMADRING_VERSION2)
 
-	volatile s64	Get;							// read pointer	(not maseked)
-	volatile u64	GetByte;						// read total bytes 
-	volatile u64	GetPktTS;						// pcap tiemstamp of last read packet 
-	u8				align2[4096-3*8];				// keep header/put/get all on seperate 4K pages
+	u64				MapSize;						// total size of the ring file, Size is only 32b
+	u64				PageSize;						// page size the ring is mapped with. MapSize is a multiple of it
 
-	fFMADRingPacket_t	Packet[FMADRING_ENTRYCNT];	// actual ring size does not need to be that deep
+	volatile u32	CursorMask;						// attached reader cursors. 0 for a legacy single reader
+	u32				Feature;						// FMADRING_FEATURE_* the ring was created with
 
-} __attribute__((packed)) fFMADRingHeader_t;
+	volatile u32	GetWake;						// futex word bumped by readers when the producer sleeps (FMADRING_FEATURE_FUTEX)
+	volatile u32	GetWaiter;						// producers sleeping on GetWake
 
-//---------------------------------------------------------------------------------------------
-// open fmad packet ring for tx 
-static inline int FMADPacket_OpenTx(	int* 				pfd, 
-										fFMADRingHeader_t** pRing, 
-										bool 				IsReset, 
-										u8* 				Path,
-										bool				IsFlowControl,
-										u64					TimeoutNS
-){
-	//check ring file size is correct
-	struct stat s;
-	memset(&s, 0, sizeof(s));
-	stat(Path, &s);
+	u32				NUMABind;						// NUMA node + 1 the ring memory is bound to, 0 if not bound
 
-	//including if no file created 
-	if (s.st_size != sizeof(fFMADRingHeader_t))
-	{
-		fprintf(stderr, "RING[%-50s] Size missmatch %lli %lli\n", Path, (u64)s.st_size, (u64)sizeof(fFMADRingHeader_t) );
+	u8				align0a[256-8*4-8*8-128-4];		// reader stats on their own cache line
 
-		int fd = open64(Path,  O_RDWR | O_CREAT, 0666);	
-		if (fd < 0)
-		{
-			fprintf(stderr, "RING[%-50s] failed to create new ring  errno:%i %s\n", Path, errno, strerror(errno)); 
-		}
-		assert(fd > 0);
+	volatile u64	GetStallCnt;					// times a reader waited on an empty ring
+	volatile u64	GetStallCycle;					// TSC cycles readers spent waiting on an empty ring
+	u8				align0b[64-2*8];
 
-		ftruncate(fd, sizeof(fFMADRingHeader_t)); 
-		close(fd);
-	}
+	volatile u64	LatCnt;							// packets received with a producer stamp (FMADRING_FEATURE_LATENCY)
+	volatile u64	LatSum;							// total write to receive latency nsec
+	volatile u64	LatMax;							// max write to receive latency nsec
+	u8				align0c[64-3*8];
 
-	// open
-	int fd  = open64(Path,  O_RDWR, S_IRWXU | S_IRWXG | 0777);	
-	if (fd < 0)
-	{
-		fprintf(stderr, "RING[%-50s] failed to create FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
-		return -1;
-	}
+	volatile u64	LatHisto[FMADRING_LAT_HISTO];	// latency histogram, see FMADPacket_LatBin
 
-	// map it
-	u8* Map = mmap64(0, FMADRING_MAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	if (Map == (u8*)-1)
-	{
-		fprintf(stderr, "RING[%-50s]failed to map RING\n", Path);
-		return -1;	
-	}
+	u8				align0[4096-256-64-64-FMADRING_LAT_HISTO*8];	// keep header/put/get all on seperate 4K pages
 
-	fFMADRingHeader_t* RING = (fFMADRingHeader_t*)Map;
+	//--------------------------------------------------------------------------------	
+	
+	volatile s64	Put;							// write pointer (not maseked)
+	volatile u64	PutByte;						// total number of bytes 
+	volatile u64	PutPktTS;						// pcap timestamp of last put packet 
+	volatile s64	PutPos;							// byte ring write offset (not masked, FMADRING_VERSION2)
+	volatile s64	GetCache;						// producers copy of the slowest reader Get, only refreshed once its out of space
+	volatile s64	GetPosCache;					// producers copy of the slowest reader GetPos (FMADRING_VERSION2)
+	u8				align1a[64-6*8];				// producers reserving slots dont disturb the consumers Put reads
+
+	volatile s64	PutReserve;						// next free slot (FMADRING_FEATURE_MPSC)
+	volatile u64	PutDropPkt;						// packets dropped on a full ring without flow control
+	volatile u64	PutDropByte;					// bytes dropped on a full ring without flow control
+	volatile u64	GetRefreshStart;				// producer refreshes of GetCache started
+	volatile u64	GetRefreshEnd;					// producer refreshes of GetCache finished
+	u8				align1b[64-5*8];				
+
+	volatile u32	PutWake;						// futex word bumped by the producer when readers sleep (FMADRING_FEATURE_FUTEX)
+	volatile u32	PutWaiter;						// readers sleeping on PutWake
+	u8				align1c[64-2*4];
+
+	volatile u64	PutStallCnt;					// times the producer waited on a full ring
+	volatile u64	PutStallCycle;					// TSC cycles the producer spent waiting on a full ring
+	volatile u64	PutTimeoutCnt;					// flow control waits that hit TxTimeout
+	volatile u64	PutOccMax;						// max occupancy seen, slots or bytes for FMADRING_VERSION2
+	u8				align1d[64-4*8];
+
+	volatile u64	PutOccHisto[FMADRING_STAT_HISTO];	// log2 occupancy histogram, bin N counts [2^(N-1), 2^N)
+	
+	u8				align1[4096-256-FMADRING_STAT_HISTO*8];	// keep header/put/get all on seperate 4K pages
 
-	// check version
-	fprintf(stderr, "RING[%-50s] Size   : %li %i\n", Path, sizeof(fFMADRingHeader_t), FMADRING_MAPSIZE);
-	fprintf(stderr, "RING[%-50s] Version: %8x %8x\n", Path, RING->Version, FMADRING_VERSION); 
+	//--------------------------------------------------------------------------------	
 
-	// version wrong then force reset
-	if (RING->Version != FMADRING_VERSION)
+	union
 	{
-		fprintf(stderr, "RING[%-50s] version wrong force reset\n", Path);
-		IsReset = true;
-	}
+		// default reader, same layout as Cursor[0]
+		struct
+		{
+			volatile s64	Get;					// read pointer	(not maseked)
+			volatile u64	GetByte;				// read total bytes 
+			volatile u64	GetPktTS;				// pcap tiemstamp of last read packet 
+			volatile s64	GetPos;					// byte ring read offset (not masked, FMADRING_VERSION2)
+		};
 
-	//reset ring
-	if (IsReset)
-	{
-		memset(RING, 0, sizeof(fFMADRingHeader_t)); 
+		// independent readers, each sees every packet 
+		fFMADRingCursor_t	Cursor[FMADRING_CURSOR_MAX];	
+	};
 
-		RING->Size			= sizeof(fFMADRingHeader_t);		
-		RING->SizePacket	= sizeof(fFMADRingPacket_t);		
+	fFMADRingPacket_t	Packet[];					// Depth entries, set when the ring is created
+													// FMADRING_VERSION2 uses this area as a byte ring 
 
-		RING->Depth			= FMADRING_ENTRYCNT;
-		RING->Mask			= FMADRING_ENTRYCNT - 1;
+} __attribute__((packed)) fFMADRingHeader_t;
 
-		RING->Put			= 0;
-		RING->Get			= 0;
+// ring creation settings 
+typedef struct fFMADRingConfig_t
+{
+	u32				Version;						// ring format FMADRING_VERSION or FMADRING_VERSION2. 
+													// 0 accepts an existing ring of either format
+	bool			IsFlowControl;					// tx waits for the consumer to drain 
+	u32				Feature;						// FMADRING_FEATURE_* to enable. 0 keeps an existing ring
+	u64				TimeoutNS;						// tx maximum timeout to wait
+
+	u64				Depth;							// number of slots (FMADRING_VERSION). power of 2
+													// 0 keeps an existing ring or creates FMADRING_ENTRYCNT
+	u64				DataSize;						// byte ring size (FMADRING_VERSION2). power of 2
+													// 0 keeps an existing ring or creates FMADRING_PACKED_DATASIZE
+	u64				HugePageSize;					// FMADRING_HUGEPAGE_2MB/1GB huge pages
+													// 0 keeps an existing ring or creates with regular pages
+													// rings on a hugetlbfs mount always use the mounts page size
+	s32				NUMANode;						// bind the ring memory to a NUMA node and pre-fault it
+													// FMADRING_NUMA_NONE keeps an existing ring or leaves it to first touch
+
+} fFMADRingConfig_t;
 
-		sfence();	
+//---------------------------------------------------------------------------------------------
+// default ring settings 
+static inline void FMADPacket_ConfigDefault(fFMADRingConfig_t* Config)
+{
+	memset(Config, 0, sizeof(fFMADRingConfig_t));
 
-		// set version last as sential the ring has been setup
-		RING->Version		= FMADRING_VERSION;		
+	Config->Version			= FMADRING_VERSION;
+	Config->IsFlowControl	= false;
+	Config->TimeoutNS		= 0;
 
-		// copy path for debug 
-		strncpy(RING->Path, Path, sizeof(RING->Path));
+	Config->Depth			= 0;
+	Config->DataSize		= 0;
+	Config->HugePageSize	= 0;
+	Config->Feature			= 0;
+	Config->NUMANode		= FMADRING_NUMA_NONE;
+}
 
-		// fixed settings
-		RING->IsTxFlowControl	= IsFlowControl;	
-		RING->TxTimeout			= TimeoutNS;	
-	}
+//---------------------------------------------------------------------------------------------
+// total size of the ring file and mapping 
+static inline u64 FMADPacket_RingSize(u32 Version, u64 Depth, u64 DataSize)
+{
+	if (Version == FMADRING_VERSION2) return sizeof(fFMADRingHeader_t) + DataSize;
 
-	// check everything matches 
-	assert(RING->Size 		== sizeof(fFMADRingHeader_t)); 
-	assert(RING->SizePacket	== sizeof(fFMADRingPacket_t)); 
-	assert(RING->Depth 		== FMADRING_ENTRYCNT); 
-	assert(RING->Mask		== FMADRING_ENTRYCNT - 1); 
+	return sizeof(fFMADRingHeader_t) + Depth * sizeof(fFMADRingPacket_t);
+}
 
-	fprintf(stderr, "RING[%-50s] Put:%llx %llx %p\n", RING->Path, RING->Put, RING->Put & RING->Mask, &RING->Put);
-	fprintf(stderr, "RING[%-50s] Get:%llx %llx %p\n", RING->Path, RING->Get, RING->Get & RING->Mask, &RING->Get);
+//---------------------------------------------------------------------------------------------
+// size of an existing ring. rings created before MapSize existed only have the 32b Size
+static inline u64 FMADPacket_MapSize(const fFMADRingHeader_t* RING)
+{
+	return (RING->MapSize != 0) ? RING->MapSize : RING->Size;
+}
+
+//---------------------------------------------------------------------------------------------
+// page size of an existing ring. rings created before PageSize existed use regular pages
+static inline u64 FMADPacket_PageSize(const fFMADRingHeader_t* RING)
+{
+	return (RING->PageSize != 0) ? RING->PageSize : FMADRING_PAGESIZE;
+}
 
+//---------------------------------------------------------------------------------------------
+// huge page size of the hugetlbfs mount the file is on, 0 for any other filesystem 
+static inline u64 FMADPacket_HugeTLBSize(int fd)
+{
+	struct statfs fs;
+	memset(&fs, 0, sizeof(fs));
+	if (fstatfs(fd, &fs) < 0) return 0;
 
-	// update files
-	if (pfd) 	pfd[0] 		= fd;
-	if (pRing) 	pRing[0] 	= RING;
+	if ((u32)fs.f_type != FMADRING_HUGETLBFS_MAGIC) return 0;
 
-	return 0;
+	return fs.f_bsize;
 }
 
 //---------------------------------------------------------------------------------------------
-// open fmad packet ring for rx 
-static inline int FMADPacket_OpenRx(	int* 				pfd, 
-										fFMADRingHeader_t** pRing, 
-										bool 				IsWait, 
-										u8* 				Path
-){
-	int fd = 0;	
-
-	fd  = open64(Path,  O_RDWR, S_IRWXU | S_IRWXG | 0777);	
-	if (fd < 0)
+// map the ring aligned to its page size so huge pages can back all of it 
+static inline u8* FMADPacket_MapRing(int fd, u64 MapSize, int Prot, u64 PageSize)
+{
+	if (PageSize <= FMADRING_PAGESIZE)
 	{
-		fprintf(stderr, "RING[%-50s] failed to create FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
-		return -1;
+		u8* Map = (u8*)mmap64(0, MapSize, Prot, MAP_SHARED, fd, 0);
+		return (Map == (u8*)-1) ? NULL : Map;
 	}
 
-	// map it
-	u8* Map = mmap64(0, FMADRING_MAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// reserve enough address space to align the start 
+	u64 ReserveSize = MapSize + PageSize;
+	u8* Reserve = (u8*)mmap64(0, ReserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (Reserve == (u8*)-1) return NULL;
+
+	u8* Aligned = (u8*)(((u64)Reserve + PageSize - 1) & ~(PageSize - 1));
+
+	u8* Map = (u8*)mmap64(Aligned, MapSize, Prot, MAP_SHARED | MAP_FIXED, fd, 0);
 	if (Map == (u8*)-1)
 	{
-		fprintf(stderr, "RING[%-50s] failed to map RING\n", Path);
-		return -1;	
+		munmap(Reserve, ReserveSize);
+		return NULL;
 	}
 
-	fFMADRingHeader_t* RING = (fFMADRingHeader_t*)Map;
-
-	// check version
-	fprintf(stderr, "RING[%-50s] Size   : %li %i %i\n", Path, sizeof(fFMADRingHeader_t), RING->Size, FMADRING_MAPSIZE);
-	fprintf(stderr, "RING[%-50s] Version: %8x %8x\n", Path, RING->Version, FMADRING_VERSION); 
+	// release the unused head and tail of the reservation
+	if (Aligned > Reserve) 						munmap(Reserve, Aligned - Reserve);
+	if (Reserve + ReserveSize > Map + MapSize)	munmap(Map + MapSize, (Reserve + ReserveSize) - (Map + MapSize));
 
-	// version wrong then force reset
-	if (RING->Version != FMADRING_VERSION)
+	// regular tmpfs files (e.g. /dev/shm) get transparent huge pages
+	if (FMADPacket_HugeTLBSize(fd) == 0)
 	{
-		fprintf(stderr, "RING[%-50s] version wrong\n", Path);
-		assert(false);
+		madvise(Map, MapSize, MADV_HUGEPAGE);
 	}
+	return Map;
+}
 
-	// check everything matches 
-	assert(RING->Size 		== sizeof(fFMADRingHeader_t)); 
-	assert(RING->SizePacket	== sizeof(fFMADRingPacket_t)); 
-	assert(RING->Depth 		== FMADRING_ENTRYCNT); 
-	assert(RING->Mask		== FMADRING_ENTRYCNT - 1); 
-
-	//reset get point to current write pointer 
-	RING->Get = RING->Put;
-
-	fprintf(stderr, "RING[%-50s] Path:%s", Path, RING->Path);
-	fprintf(stderr, "RING[%-50s] Put:%llx %llx\n", Path, RING->Put, RING->Put & RING->Mask);
-	fprintf(stderr, "RING[%-50s] Get:%llx %llx\n", Path, RING->Get, RING->Get & RING->Mask);
-
-	// update files
-	if (pfd) 	pfd[0] 		= fd;
-	if (pRing) 	pRing[0] 	= RING;
+//---------------------------------------------------------------------------------------------
+// memory policy only places the pages of shared memory files, tmpfs and hugetlbfs. page cache
+// pages of a ring file on a regular filesystem (e.g. /opt/fmadio/queue) ignore it
+static inline bool FMADPacket_NUMAFile(int fd)
+{
+	struct statfs fs;
+	memset(&fs, 0, sizeof(fs));
+	if (fstatfs(fd, &fs) < 0) return false;
 
-	return 0;
+	return ((u32)fs.f_type == FMADRING_TMPFS_MAGIC) || ((u32)fs.f_type == FMADRING_HUGETLBFS_MAGIC);
 }
 
 //---------------------------------------------------------------------------------------------
-// open fmad packet ring for monitoring only (read only) 
-static inline int FMADPacket_OpenMon(	int* 				pfd, 
-										fFMADRingHeader_t** pRing, 
-										u8* 				Path
-){
-	int fd = 0;	
+// bind a new ring mapping to a NUMA node and fault every page in. the shared file keeps 
+// the policy so the pages stay on the node whoever maps them. pages left on another node 
+// (an earlier ring in the same file, a node without free memory) are found by sampling 
+// where they landed
+// returns 0 if the ring is on the node, 1 if it could not be placed there and -1 on error
+static inline int FMADPacket_NUMABind(int fd, u8* Map, u64 MapSize, u64 PageSize, int Node)
+{
+	if (!FMADPacket_NUMAFile(fd)) return 1;
 
-	fd  = open64(Path,  O_RDONLY, S_IRWXU | S_IRWXG | 0777);	
-	if (fd < 0)
-	{
-		fprintf(stderr, "RING[%-50s] ERROR failed to open FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
-		return -1;
-	}
+	unsigned long NodeMask = 1UL << Node;
+	if (syscall(SYS_mbind, Map, MapSize, FMADRING_MPOL_BIND, &NodeMask, FMADRING_NUMA_MAX + 1, FMADRING_MPOL_MF_MOVE) < 0) return -1;
 
-	// map it
-	u8* Map = mmap64(0, FMADRING_MAPSIZE, PROT_READ, MAP_SHARED, fd, 0);
-	if (Map == (u8*)-1)
+	volatile u8* Page = Map;
+	for (u64 Offset = 0; Offset < MapSize; Offset += PageSize)
 	{
-		fprintf(stderr, "RING[%-50s] ERROR failed to map RING (read only)\n", Path);
-		return -1;	
+		Page[Offset] = Page[Offset];
 	}
 
-	fFMADRingHeader_t* RING = (fFMADRingHeader_t*)Map;
+	// pages spread evenly over the ring, nodes NULL only reports where they are
+	u64 PageCnt = MapSize / PageSize;
+	u64 Step	= (PageCnt + FMADRING_NUMA_CHECK - 1) / FMADRING_NUMA_CHECK;
 
-	// version wrong then force reset
-	if (RING->Version != FMADRING_VERSION)
+	void* Pages[FMADRING_NUMA_CHECK];
+	int Status[FMADRING_NUMA_CHECK];
+	u32 Cnt = 0;
+	for (u64 i = 0; (i < PageCnt) && (Cnt < FMADRING_NUMA_CHECK); i += Step)
 	{
-		fprintf(stderr, "RING[%-50s] ERROR version wrong\n", Path);
-		return -1;
+		Pages[Cnt++] = Map + i * PageSize;
 	}
+	if (syscall(SYS_move_pages, 0, Cnt, Pages, NULL, Status, 0) < 0) return 1;
 
-	// check everything matches 
-	assert(RING->Size 		== sizeof(fFMADRingHeader_t)); 
-	assert(RING->SizePacket	== sizeof(fFMADRingPacket_t)); 
-	assert(RING->Depth 		== FMADRING_ENTRYCNT); 
-	assert(RING->Mask		== FMADRING_ENTRYCNT - 1); 
-
-	fprintf(stderr, "RING[%-50s] Status GOOD\n", Path);
-
-	// update files
-	if (pfd) 	pfd[0] 		= fd;
-	if (pRing) 	pRing[0] 	= RING;
-
+	for (u32 i=0; i < Cnt; i++)
+	{
+		if (Status[i] != Node) return 1;
+	}
 	return 0;
 }
 
+// NUMA node the ring memory is bound to, FMADRING_NUMA_NONE if not bound
+static inline int FMADPacket_NUMANode(const fFMADRingHeader_t* RING)
+{
+	return (int)RING->NUMABind - 1;
+}
+
+// NUMA node of a cpu, FMADRING_NUMA_NONE if unknown
+static inline int FMADPacket_CPUNode(int CPU)
+{
+	for (int Node=0; Node < FMADRING_NUMA_MAX; Node++)
+	{
+		char Path[128];
+		snprintf(Path, sizeof(Path), "/sys/devices/system/cpu/cpu%i/node%i", CPU, Node);
+		if (access(Path, F_OK) == 0) return Node;
+	}
+	return FMADRING_NUMA_NONE;
+}
 
 //---------------------------------------------------------------------------------------------
-// write packet 
-static inline int FMADPacket_SendV1(	fFMADRingHeader_t* 	RING, 
-										u64 				TS, 
-										u32 				LengthWire,
-										u32 				LengthCapture,
-										u32 				Port,
-										u32					Flag,
-										u64					StorageID,
-										void*	 			Payload
-									)
+// cpu to pin a reader or writer of the ring to. FMADRING_CPU_AUTO picks the first cpu the 
+// process may use on the rings NUMA node, a cpu on another node is warned about. -1 does not pin
+static inline int FMADPacket_NUMACPU(const fFMADRingHeader_t* RING, int CPU)
 {
-	// wait for space 
-	u64 TS0 = rdtsc();
-	while (RING->IsTxFlowControl)
+	int Node = FMADPacket_NUMANode(RING);
+	if (CPU == FMADRING_CPU_AUTO)
 	{
-		s64 dQueue = RING->Put - RING->Get;
-		if (dQueue < RING->Depth-1) break; 
-
-		usleep(0);
-
-		u64 dTSC = (rdtsc() - TS0);
-		if (tsc2ns(dTSC) > RING->TxTimeout)
+		if (Node == FMADRING_NUMA_NONE)
 		{
-			fprintf(stderr, "RING[%-50s] ERROR RING wait for drain timeout %lli > %lli\n", RING->Path, tsc2ns(dTSC), RING->TxTimeout);
+			fprintf(stderr, "RING[%-50s] not bound to a NUMA node, cpu auto does not pin\n", RING->Path);
 			return -1;
 		}
-	}
 
-	// write packet
-	fFMADRingPacket_t* FPkt = &RING->Packet[ RING->Put & RING->Mask ];
-	FPkt->TS				= TS;
-	FPkt->LengthWire		= LengthWire;
-	FPkt->LengthCapture		= LengthCapture;
-	FPkt->Port				= 0; 
-	FPkt->Flag				= Flag; 
-	FPkt->StorageID			= StorageID; 
-	memcpy(&FPkt->Payload[0], Payload, LengthCapture);
+		cpu_set_t Mask;
+		CPU_ZERO(&Mask);
+		sched_getaffinity(0, sizeof(Mask), &Mask);
+		for (int i=0; i < CPU_SETSIZE; i++)
+		{
+			if (!CPU_ISSET(i, &Mask) || (FMADPacket_CPUNode(i) != Node)) continue;
 
-	sfence();
+			fprintf(stderr, "RING[%-50s] NUMA node %i local cpu %i\n", RING->Path, Node, i);
+			return i;
+		}
 
-	// publish 
-	RING->Put 				+= 1;
-	RING->PutByte 			+= LengthCapture;
-	RING->PutPktTS 			= TS;
+		fprintf(stderr, "RING[%-50s] WARNING no usable cpu on NUMA node %i, not pinned\n", RING->Path, Node);
+		return -1;
+	}
 
-	return LengthCapture;
+	if ((CPU >= 0) && (Node != FMADRING_NUMA_NONE))
+	{
+		int CPUNode = FMADPacket_CPUNode(CPU);
+		if ((CPUNode != FMADRING_NUMA_NONE) && (CPUNode != Node))
+		{
+			fprintf(stderr, "RING[%-50s] WARNING cpu %i is on NUMA node %i, the ring is on node %i. use --cpu auto for a local cpu\n", RING->Path, CPU, CPUNode, Node);
+		}
+	}
+	return CPU;
 }
 
-
 //---------------------------------------------------------------------------------------------
-// send EOF marker 
-static inline int FMADPacket_SendEOFV1(	fFMADRingHeader_t* 	RING, u64 TS)
+// validate a rings header against the file its mapped from 
+static inline int FMADPacket_CheckHeader(const fFMADRingHeader_t* RING, u64 FileSize, u8* Path)
 {
-	// wait for space 
-	u64 TS0 = rdtsc();
-	while (RING->IsTxFlowControl)
+	if ((RING->Version != FMADRING_VERSION) && (RING->Version != FMADRING_VERSION2))
 	{
-		s64 dQueue = RING->Put - RING->Get;
-		if (dQueue < RING->Depth-1) break; 
-
-		usleep(0);
+		fprintf(stderr, "RING[%-50s] ERROR version wrong %08x\n", Path, RING->Version);
+		return -1;
+	}
+	if (RING->SizePacket != sizeof(fFMADRingPacket_t))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR packet size wrong %i %li\n", Path, RING->SizePacket, sizeof(fFMADRingPacket_t));
+		return -1;
+	}
+	if ((RING->Depth == 0) || (RING->Depth & RING->Mask) || (RING->Mask != RING->Depth - 1))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR depth invalid %lli mask %llx\n", Path, RING->Depth, RING->Mask);
+		return -1;
+	}
 
-		u64 dTSC = (rdtsc() - TS0);
-		if (tsc2ns(dTSC) > RING->TxTimeout)
-		{
-			fprintf(stderr, "RING[%-50s] ERROR: RING wait for drain timeout EOF %lli %lli\n", RING->Path, tsc2ns(dTSC), RING->TxTimeout);
-			return -1;
-		}
+	u64 PageSize = FMADPacket_PageSize(RING);
+	if ((PageSize < FMADRING_PAGESIZE) || (PageSize & (PageSize - 1)) || (FMADPacket_MapSize(RING) & (PageSize - 1)))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR page size invalid %lli map %lli\n", Path, PageSize, FMADPacket_MapSize(RING));
+		return -1;
 	}
 
-	// write packet
+	// everything the ring indexes must be inside the file
+	u64 RingSize = FMADPacket_RingSize(RING->Version, RING->Depth, RING->DataSize);
+	if ((RingSize > FMADPacket_MapSize(RING)) || (FMADPacket_MapSize(RING) > FileSize))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR size missmatch ring %lli map %lli file %lli\n", Path, RingSize, FMADPacket_MapSize(RING), FileSize);
+		return -1;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for tx with specific creation settings 
+static inline int FMADPacket_OpenTxConfig(	int* 						pfd, 
+											fFMADRingHeader_t** 		pRing, 
+											bool 						IsReset, 
+											u8* 						Path,
+											const fFMADRingConfig_t*	Config
+){
+	// open including if no file created 
+	int fd  = open64((char*)Path,  O_RDWR | O_CREAT, 0666);	
+	if (fd < 0)
+	{
+		fprintf(stderr, "RING[%-50s] failed to create FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
+		return -1;
+	}
+
+	struct stat s;
+	memset(&s, 0, sizeof(s));
+	fstat(fd, &s);
+
+	// read the current header, zero if the file is new
+	fFMADRingHeader_t Current;
+	memset(&Current, 0, sizeof(Current));
+	if (s.st_size >= sizeof(fFMADRingHeader_t))
+	{
+		pread(fd, &Current, sizeof(Current), 0);
+	}
+
+	// version wrong then force reset
+	bool IsVersionOK = (Current.Version == FMADRING_VERSION) || (Current.Version == FMADRING_VERSION2);
+	if (Config->Version != 0) IsVersionOK = (Current.Version == Config->Version);
+
+	fprintf(stderr, "RING[%-50s] Version: %8x %8x\n", Path, Current.Version, Config->Version); 
+	if (!IsVersionOK)
+	{
+		fprintf(stderr, "RING[%-50s] version wrong force reset\n", Path);
+		IsReset = true;
+	}
+	else if (FMADPacket_CheckHeader(&Current, s.st_size, Path) < 0)
+	{
+		fprintf(stderr, "RING[%-50s] header invalid force reset\n", Path);
+		IsReset = true;
+	}
+
+	// requested size differs from the existing ring
+	if ((Current.Version == FMADRING_VERSION) && (Config->Depth != 0) && (Config->Depth != Current.Depth))
+	{
+		fprintf(stderr, "RING[%-50s] Depth missmatch %lli %lli force reset\n", Path, Current.Depth, Config->Depth);
+		IsReset = true;
+	}
+	if ((Current.Version == FMADRING_VERSION2) && (Config->DataSize != 0) && (Config->DataSize != Current.DataSize))
+	{
+		fprintf(stderr, "RING[%-50s] DataSize missmatch %lli %lli force reset\n", Path, Current.DataSize, Config->DataSize);
+		IsReset = true;
+	}
+
+	// page size for the ring, hugetlbfs files can only use the mounts page size
+	u64 HugeTLBSize	= FMADPacket_HugeTLBSize(fd);
+	u64 PageSize	= FMADRING_PAGESIZE;
+	if (Config->HugePageSize != 0)	PageSize = Config->HugePageSize;
+	if (HugeTLBSize != 0)			PageSize = HugeTLBSize;
+
+	if ((HugeTLBSize != 0) && (Config->HugePageSize != 0) && (Config->HugePageSize != HugeTLBSize))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR hugetlbfs page size %lli does not match requested %lli\n", Path, HugeTLBSize, Config->HugePageSize);
+		close(fd);
+		return -1;
+	}
+	if ((HugeTLBSize == 0) && (PageSize > FMADRING_HUGEPAGE_2MB))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR page size %lli requires the ring on a hugetlbfs mount\n", Path, PageSize);
+		close(fd);
+		return -1;
+	}
+	if ((PageSize < FMADRING_PAGESIZE) || (PageSize & (PageSize - 1)))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR page size %lli must be a power of 2\n", Path, PageSize);
+		close(fd);
+		return -1;
+	}
+	if (IsVersionOK && (PageSize != FMADRING_PAGESIZE) && (FMADPacket_PageSize(&Current) != PageSize))
+	{
+		fprintf(stderr, "RING[%-50s] PageSize missmatch %lli %lli force reset\n", Path, FMADPacket_PageSize(&Current), PageSize);
+		IsReset = true;
+	}
+	if (IsVersionOK && (Config->Feature != 0) && ((Current.Feature & ~FMADRING_FEATURE_SEQ) != (Config->Feature & ~FMADRING_FEATURE_SEQ)))
+	{
+		fprintf(stderr, "RING[%-50s] Feature missmatch %08x %08x force reset\n", Path, Current.Feature, Config->Feature);
+		IsReset = true;
+	}
+	if (IsVersionOK && (Config->NUMANode != FMADRING_NUMA_NONE) && (Current.NUMABind != Config->NUMANode + 1) && FMADPacket_NUMAFile(fd))
+	{
+		fprintf(stderr, "RING[%-50s] NUMA node missmatch %i %i force reset\n", Path, (s32)Current.NUMABind - 1, Config->NUMANode);
+		IsReset = true;
+	}
+	if ((Config->NUMANode != FMADRING_NUMA_NONE) && ((Config->NUMANode < 0) || (Config->NUMANode >= FMADRING_NUMA_MAX)))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR NUMA node %i must be 0 - %i\n", Path, Config->NUMANode, FMADRING_NUMA_MAX - 1);
+		close(fd);
+		return -1;
+	}
+	if ((Config->Feature & FMADRING_FEATURE_MPSC) && (Config->Version == FMADRING_VERSION2))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR multiple producers requires a fixed slot ring\n", Path);
+		close(fd);
+		return -1;
+	}
+
+	// new ring geometry
+	u32 Version		= (Config->Version != 0) ? Config->Version : FMADRING_VERSION;
+	u64 Depth		= (Config->Depth != 0) ? Config->Depth : FMADRING_ENTRYCNT;
+	u64 DataSize	= (Config->DataSize != 0) ? Config->DataSize : FMADRING_PACKED_DATASIZE;
+	if (Version == FMADRING_VERSION2)
+	{
+		// size the slot counter to the max number of records
+		Depth		= DataSize / FMADRING_PACKED_ALIGN;
+	}
+	else
+	{
+		DataSize	= 0;
+	}
+
+	if ((Depth < 2) || (Depth & (Depth - 1)))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR depth %lli must be a power of 2\n", Path, Depth);
+		close(fd);
+		return -1;
+	}
+	if ((Version == FMADRING_VERSION2) && ((DataSize < 64*1024) || (DataSize & (DataSize - 1))))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR packed size %lli must be a power of 2 and at least 64KB\n", Path, DataSize);
+		close(fd);
+		return -1;
+	}
+
+	// size the file for the new ring, rounded up to whole pages
+	u64 MapSize = FMADPacket_MapSize(&Current);
+	if (!IsReset)
+	{
+		PageSize = FMADPacket_PageSize(&Current);
+	}
+	else
+	{
+		MapSize = FMADPacket_RingSize(Version, Depth, DataSize);
+		MapSize = (MapSize + PageSize - 1) & ~(PageSize - 1);
+	}
+	if (IsReset && (s.st_size != MapSize))
+	{
+		fprintf(stderr, "RING[%-50s] Size missmatch %lli %lli\n", Path, (u64)s.st_size, MapSize);
+		if (ftruncate(fd, MapSize) < 0)
+		{
+			fprintf(stderr, "RING[%-50s] failed to size ring %lli errno:%i %s\n", Path, MapSize, errno, strerror(errno)); 
+			close(fd);
+			return -1;
+		}
+	}
+
+	// map it
+	u8* Map = FMADPacket_MapRing(fd, MapSize, PROT_READ | PROT_WRITE, PageSize);
+	if (Map == NULL)
+	{
+		fprintf(stderr, "RING[%-50s]failed to map RING errno:%i %s\n", Path, errno, strerror(errno));
+		close(fd);
+		return -1;	
+	}
+
+	fFMADRingHeader_t* RING = (fFMADRingHeader_t*)Map;
+
+	// new ring memory on a fixed node, faulted in now instead of by whoever touches it first.
+	// only recorded in the header once the pages are known to be there
+	s32 NUMANode = FMADRING_NUMA_NONE;
+	if (IsReset && (Config->NUMANode != FMADRING_NUMA_NONE))
+	{
+		int ret = FMADPacket_NUMABind(fd, Map, MapSize, PageSize, Config->NUMANode);
+		if (ret < 0)
+		{
+			fprintf(stderr, "RING[%-50s] ERROR failed to bind to NUMA node %i errno:%i %s\n", Path, Config->NUMANode, errno, strerror(errno));
+			munmap(Map, MapSize);
+			close(fd);
+			return -1;
+		}
+		if (ret > 0)
+		{
+			fprintf(stderr, "RING[%-50s] WARNING ring memory is not on NUMA node %i (only tmpfs or hugetlbfs files can be placed), not bound\n", Path, Config->NUMANode);
+		}
+		else
+		{
+			NUMANode = Config->NUMANode;
+		}
+	}
+
+	fprintf(stderr, "RING[%-50s] Size   : %lli PageSize:%lli\n", Path, MapSize, PageSize);
+
+	//reset ring
+	if (IsReset)
+	{
+		// slot contents are never read before being written, only the header and 
+		// the slot commit stamps need clearing
+		memset(RING, 0, sizeof(fFMADRingHeader_t)); 
+		if (Version == FMADRING_VERSION)
+		{
+			for (u64 i=0; i < Depth; i++) RING->Packet[i].Seq = 0;
+		}
+
+		RING->MapSize		= MapSize;
+		RING->PageSize		= PageSize;
+		RING->Size			= (MapSize < 0x100000000ULL) ? MapSize : 0xffffffff;		
+		RING->SizePacket	= sizeof(fFMADRingPacket_t);		
+
+		RING->Depth			= Depth;
+		RING->Mask			= Depth - 1;
+
+		RING->Put			= 0;
+		RING->Get			= 0;
+
+		// packed ring re-uses the slot area as a byte ring
+		if (Version == FMADRING_VERSION2)
+		{
+			RING->DataSize	= DataSize; 
+			RING->DataMask	= DataSize - 1; 
+		}
+		RING->PutPos		= 0;
+		RING->GetPos		= 0;
+		RING->PutReserve	= 0;
+		RING->GetCache		= 0;
+		RING->GetPosCache	= 0;
+
+		// slot stamps are set by the ring itself, only a producer that can lap its readers needs them
+		RING->Feature		= Config->Feature & ~FMADRING_FEATURE_SEQ;
+		if ((Version == FMADRING_VERSION) && !Config->IsFlowControl && ((Config->Feature & FMADRING_FEATURE_MPSC) == 0))
+		{
+			RING->Feature	|= FMADRING_FEATURE_SEQ;
+		}
+		RING->NUMABind		= (NUMANode != FMADRING_NUMA_NONE) ? NUMANode + 1 : 0;
+
+		sfence();	
+
+		// set version last as sential the ring has been setup
+		RING->Version		= Version;		
+
+		// copy path for debug 
+		strncpy((char*)RING->Path, (char*)Path, sizeof(RING->Path));
+
+		// fixed settings
+		RING->IsTxFlowControl	= Config->IsFlowControl;	
+		RING->TxTimeout			= Config->TimeoutNS;	
+	}
+
+	// check everything matches 
+	assert(FMADPacket_CheckHeader(RING, MapSize, Path) == 0);
+
+	fprintf(stderr, "RING[%-50s] Depth:%lli\n", RING->Path, RING->Depth);
+	fprintf(stderr, "RING[%-50s] Put:%llx %llx %p\n", RING->Path, RING->Put, RING->Put & RING->Mask, &RING->Put);
+	fprintf(stderr, "RING[%-50s] Get:%llx %llx %p\n", RING->Path, RING->Get, RING->Get & RING->Mask, &RING->Get);
+
+
+	// update files
+	if (pfd) 	pfd[0] 		= fd;
+	if (pRing) 	pRing[0] 	= RING;
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for tx 
+static inline int FMADPacket_OpenTx(	int* 				pfd, 
+										fFMADRingHeader_t** pRing, 
+										bool 				IsReset, 
+										u8* 				Path,
+										bool				IsFlowControl,
+										u64					TimeoutNS
+){
+	fFMADRingConfig_t Config;
+	FMADPacket_ConfigDefault(&Config);
+
+	Config.IsFlowControl	= IsFlowControl;
+	Config.TimeoutNS		= TimeoutNS;
+
+	return FMADPacket_OpenTxConfig(pfd, pRing, IsReset, Path, &Config);
+}
+
+//---------------------------------------------------------------------------------------------
+// map an existing ring sized from its header 
+static inline fFMADRingHeader_t* FMADPacket_MapExisting(int fd, bool IsReadOnly, u8* Path)
+{
+	struct stat s;
+	memset(&s, 0, sizeof(s));
+	fstat(fd, &s);
+
+	// header first to find the full size of the ring
+	fFMADRingHeader_t Current;
+	memset(&Current, 0, sizeof(Current));
+	if ((s.st_size < sizeof(fFMADRingHeader_t)) || (pread(fd, &Current, sizeof(Current), 0) != sizeof(Current)))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR file too small %lli\n", Path, (u64)s.st_size);
+		return NULL;
+	}
+	if (FMADPacket_CheckHeader(&Current, s.st_size, Path) < 0)
+	{
+		return NULL;
+	}
+
+	// hugetlbfs rings can only be mapped with the mounts page size
+	u64 PageSize	= FMADPacket_PageSize(&Current);
+	u64 HugeTLBSize	= FMADPacket_HugeTLBSize(fd);
+	if ((HugeTLBSize != 0) && (HugeTLBSize != PageSize))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR hugetlbfs page size %lli ring page size %lli\n", Path, HugeTLBSize, PageSize);
+		return NULL;
+	}
+
+	// map it
+	u64 MapSize = FMADPacket_MapSize(&Current);
+	int Prot 	= IsReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
+	u8* Map 	= FMADPacket_MapRing(fd, MapSize, Prot, PageSize);
+	if (Map == NULL)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR failed to map RING %lli errno:%i %s\n", Path, MapSize, errno, strerror(errno));
+		return NULL;	
+	}
+
+	fprintf(stderr, "RING[%-50s] Size   : %lli Depth:%lli PageSize:%lli\n", Path, MapSize, Current.Depth, PageSize);
+	fprintf(stderr, "RING[%-50s] Version: %8x\n", Path, Current.Version); 
+
+	return (fFMADRingHeader_t*)Map;
+}
+
+//---------------------------------------------------------------------------------------------
+// FMADRING_FEATURE_FUTEX blocking wait. an idle side registers in the waiter count then sleeps
+// on the wake word, the other side only bumps the word and makes the syscall when it sees a
+// waiter. the futex is not process private as the ring is shared between processes 
+
+// sleep while the word is Seq, up to TimeoutNS. words are 4B aligned in the header 
+static inline void FMADPacket_FutexWait(volatile void* Word, u32 Seq, u64 TimeoutNS)
+{
+	struct timespec TS;
+	TS.tv_sec	= TimeoutNS / 1000000000ULL;
+	TS.tv_nsec	= TimeoutNS % 1000000000ULL;
+
+	syscall(SYS_futex, Word, FMADRING_FUTEX_WAIT, Seq, &TS, NULL, 0);
+}
+
+// wake everyone sleeping on the word 
+static inline void FMADPacket_FutexWake(volatile void* Word, volatile void* Waiter)
+{
+	// the caller published before this, Dekker style with the waiters register then check
+	mfence();
+	if (((volatile u32*)Waiter)[0] == 0) return;
+
+	__sync_fetch_and_add((volatile u32*)Word, 1);
+	syscall(SYS_futex, Word, FMADRING_FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+// producer published, wake sleeping readers 
+static inline void FMADPacket_PutNotify(fFMADRingHeader_t* RING)
+{
+	if ((RING->Feature & FMADRING_FEATURE_FUTEX) == 0) return;
+
+	FMADPacket_FutexWake(&RING->PutWake, &RING->PutWaiter);
+}
+
+// reader released slots, wake a sleeping producer 
+static inline void FMADPacket_GetNotify(fFMADRingHeader_t* RING)
+{
+	if ((RING->Feature & FMADRING_FEATURE_FUTEX) == 0) return;
+
+	FMADPacket_FutexWake(&RING->GetWake, &RING->GetWaiter);
+}
+
+//---------------------------------------------------------------------------------------------
+// producer has no space, give the readers time to drain. the first call registers as a 
+// waiter and returns straight away so the caller re-checks the ring before sleeping
+// returns -1 once TxTimeout has passed since TS0
+static inline int FMADPacket_SendSleep(	fFMADRingHeader_t* 	RING, 
+										u64					TS0,
+										bool*				pIsWaiter,
+										u32					WakeSeq
+									)
+{
+	if (RING->Feature & FMADRING_FEATURE_FUTEX)
+	{
+		if (!pIsWaiter[0])
+		{
+			__sync_fetch_and_add(&RING->GetWaiter, 1);
+			pIsWaiter[0] = true;
+			return 0;
+		}
+		FMADPacket_FutexWait(&RING->GetWake, WakeSeq, FMADRING_FUTEX_TIMEOUT);
+	}
+	else
+	{
+		usleep(0);
+	}
+
+	u64 dTSC = (rdtsc() - TS0);
+	if (tsc2ns(dTSC) > RING->TxTimeout)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR RING wait for drain timeout %lli > %lli\n", RING->Path, tsc2ns(dTSC), RING->TxTimeout);
+		__sync_fetch_and_add(&RING->PutTimeoutCnt, 1);
+		return -1;
+	}
+	return 0;
+}
+
+// producer finished waiting 
+static inline void FMADPacket_SendSleepEnd(fFMADRingHeader_t* RING, bool* pIsWaiter)
+{
+	if (!pIsWaiter[0]) return;
+
+	__sync_fetch_and_sub(&RING->GetWaiter, 1);
+	pIsWaiter[0] = false;
+}
+
+//---------------------------------------------------------------------------------------------
+// reader cursors. every attached reader has its own position on the Get page and sees every
+// packet. the producer only frees a slot once all active readers are past it. Cursor[0] is the
+// default reader used by FMADPacket_OpenRx and shares its layout with the legacy Get fields,
+// so readers built before cursors existed keep working. CursorMask of 0 means a legacy
+// reader, flow control then keys off the default Get only
+
+// oldest read position of the attached readers, the producer can not pass it 
+static inline s64 FMADPacket_GetMin(fFMADRingHeader_t* RING, bool IsPacked)
+{
+	u32 Mask = RING->CursorMask;
+	if (Mask == 0) return IsPacked ? RING->GetPos : RING->Get;
+
+	s64 Min = IsPacked ? RING->PutPos : RING->Put;
+	while (Mask != 0)
+	{
+		u32 Index = __builtin_ctz(Mask);
+		Mask &= Mask - 1;
+
+		fFMADRingCursor_t* C = &RING->Cursor[Index];
+		s64 Get = IsPacked ? C->GetPos : C->Get;
+		if (Get < Min) Min = Get;
+	}
+	return Min;
+}
+
+// re-read the reader cursors into the producers cached copy. the cache only ever lags 
+// the readers so the free space it gives is never more than the real free space. the 
+// refresh is bracketed by the Start/End counts so a resuming reader can wait out one that
+// read the cursors before it was attached, see FMADPacket_CursorResume
+static inline s64 FMADPacket_GetRefresh(fFMADRingHeader_t* RING, bool IsPacked)
+{
+	// locked, the cursor reads can not move ahead of it
+	__sync_fetch_and_add(&RING->GetRefreshStart, 1);
+
+	s64 Min = FMADPacket_GetMin(RING, IsPacked);
+	if (IsPacked)	RING->GetPosCache	= Min;
+	else			RING->GetCache		= Min;
+
+	__sync_fetch_and_add(&RING->GetRefreshEnd, 1);
+
+	return Min;
+}
+
+//---------------------------------------------------------------------------------------------
+// ring telemetry. producer counters live on the Put page and reader counters on their own
+// line of the config page, so the hot Put/Get lines are not touched. occupancy is sampled
+// against the real reader positions once every FMADRING_STAT_SAMPLE packets, which also 
+// refreshes the producers cached Get
+
+// producer published up to Put, previously PutPrev
+static inline void FMADPacket_StatPublish(fFMADRingHeader_t* RING, s64 PutPrev, s64 Put)
+{
+	if ((PutPrev / FMADRING_STAT_SAMPLE) == (Put / FMADRING_STAT_SAMPLE)) return;
+
+	s64 Occ = 0;
+	if (RING->Version == FMADRING_VERSION2)	Occ = RING->PutPos - FMADPacket_GetRefresh(RING, true);
+	else									Occ = Put - FMADPacket_GetRefresh(RING, false);
+
+	u32 Bin = (Occ <= 0) ? 0 : 64 - __builtin_clzll(Occ);
+	if (Bin >= FMADRING_STAT_HISTO) Bin = FMADRING_STAT_HISTO - 1;
+
+	RING->PutOccHisto[Bin]++;
+	if (Occ > RING->PutOccMax) RING->PutOccMax = Occ;
+}
+
+// producer waited on a full ring since TS0
+static inline void FMADPacket_StatSendStall(fFMADRingHeader_t* RING, u64 TS0)
+{
+	__sync_fetch_and_add(&RING->PutStallCnt, 1);
+	__sync_fetch_and_add(&RING->PutStallCycle, rdtsc() - TS0);
+}
+
+// reader waited on an empty ring since TS0
+static inline void FMADPacket_StatRecvStall(fFMADRingHeader_t* RING, u64 TS0)
+{
+	__sync_fetch_and_add(&RING->GetStallCnt, 1);
+	__sync_fetch_and_add(&RING->GetStallCycle, rdtsc() - TS0);
+}
+
+//---------------------------------------------------------------------------------------------
+// detach a reader, the producer no longer waits for it. its position is kept
+static inline void FMADPacket_CursorDetach(fFMADRingHeader_t* RING, fFMADRingCursor_t* C)
+{
+	u32 Index = C - RING->Cursor;
+
+	__sync_fetch_and_and(&RING->CursorMask, ~(1U << Index));
+
+	C->PID		= 0;
+	C->Flag		= 0;
+
+	// producer may be waiting on this reader
+	FMADPacket_GetNotify(RING);
+}
+
+//---------------------------------------------------------------------------------------------
+// detach readers whose process has exited without detaching 
+static inline void FMADPacket_CursorExpire(fFMADRingHeader_t* RING)
+{
+	u32 Mask = RING->CursorMask;
+	while (Mask != 0)
+	{
+		u32 Index = __builtin_ctz(Mask);
+		Mask &= Mask - 1;
+
+		fFMADRingCursor_t* C = &RING->Cursor[Index];
+		if (C->PID == 0) continue;
+
+		if ((kill(C->PID, 0) < 0) && (errno == ESRCH))
+		{
+			fprintf(stderr, "RING[%-50s] reader %i [%s] pid %i exited, detaching\n", RING->Path, Index, C->Name, C->PID);
+			FMADPacket_CursorDetach(RING, C);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// start a claimed cursor at the current write position and make it active 
+static inline void FMADPacket_CursorStart(fFMADRingHeader_t* RING, fFMADRingCursor_t* C)
+{
+	u32 Index = C - RING->Cursor;
+
+	C->PID		= getpid();
+	C->Get		= RING->Put;
+	C->GetPos	= RING->PutPos;
+	C->GetByte	= RING->PutByte;
+	C->GetPktTS	= RING->PutPktTS;
+
+	sfence();
+
+	C->Flag		= FMADRING_CURSOR_FLAG_ACTIVE;
+	__sync_fetch_and_or(&RING->CursorMask, 1U << Index);
+
+	// catch up with anything published before the producer saw the cursor 
+	C->Get		= RING->Put;
+	C->GetPos	= RING->PutPos;
+
+	C->PutCache		= C->Get;
+	C->PutPosCache	= C->GetPos;
+}
+
+//---------------------------------------------------------------------------------------------
+// claim the cursor for a named reader, its old cursor if it has attached before. pIsPrev is
+// set if the cursor still holds the readers previous position. the cursor is not started
+// returns the cursor, NULL if the name is in use or all cursors are taken
+static inline fFMADRingCursor_t* FMADPacket_CursorClaim(fFMADRingHeader_t* RING, const u8* Name, bool* pIsPrev)
+{
+	// free cursors held by readers that have gone away
+	FMADPacket_CursorExpire(RING);
+
+	fFMADRingCursor_t* C = NULL;
+	if (pIsPrev) pIsPrev[0] = false;
+
+	// previous cursor with the same name
+	for (int i=1; i < FMADRING_CURSOR_MAX; i++)
+	{
+		fFMADRingCursor_t* Cur = &RING->Cursor[i];
+		if (strncmp((char*)Cur->Name, (const char*)Name, sizeof(Cur->Name)) != 0) continue;
+
+		if (!__sync_bool_compare_and_swap(&Cur->Flag, 0, FMADRING_CURSOR_FLAG_CLAIM))
+		{
+			fprintf(stderr, "RING[%-50s] ERROR reader [%s] already attached pid %i\n", RING->Path, Name, Cur->PID);
+			return NULL;
+		}
+		C = Cur;
+		if (pIsPrev) pIsPrev[0] = true;
+		break;
+	}
+
+	// any free cursor, prefering ones never used
+	for (int Pass=0; (Pass < 2) && (C == NULL); Pass++)
+	{
+		for (int i=1; i < FMADRING_CURSOR_MAX; i++)
+		{
+			fFMADRingCursor_t* Cur = &RING->Cursor[i];
+			if ((Pass == 0) && (Cur->Name[0] != 0)) continue;
+
+			if (__sync_bool_compare_and_swap(&Cur->Flag, 0, FMADRING_CURSOR_FLAG_CLAIM))
+			{
+				C = Cur;
+				break;
+			}
+		}
+	}
+	if (C == NULL)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR no free reader cursors for [%s]\n", RING->Path, Name);
+		return NULL;
+	}
+
+	memset(C->Name, 0, sizeof(C->Name));
+	strncpy((char*)C->Name, (const char*)Name, sizeof(C->Name) - 1);
+
+	return C;
+}
+
+//---------------------------------------------------------------------------------------------
+// attach a named reader at the current write position
+// returns the cursor, NULL if the name is in use or all cursors are taken
+static inline fFMADRingCursor_t* FMADPacket_CursorAttach(fFMADRingHeader_t* RING, const u8* Name)
+{
+	fFMADRingCursor_t* C = FMADPacket_CursorClaim(RING, Name, NULL);
+	if (C == NULL) return NULL;
+
+	FMADPacket_CursorStart(RING, C);
+
+	fprintf(stderr, "RING[%-50s] reader %li [%s] attached Get:%llx\n", RING->Path, C - RING->Cursor, C->Name, C->Get);
+
+	return C;
+}
+
+//---------------------------------------------------------------------------------------------
+// work-sharing group. several workers drain one cursor cooperatively, each packet goes to one
+// worker. workers claim slots by advancing the cursors Claim, Get is the completion cursor and 
+// advances in claim order so the producer only re-uses slots every worker is done with.
+// a group spanning several processes is not expired, each member must detach
+// FMADRING_VERSION only
+
+// join the named group, creating it if its the first member
+// returns the groups cursor, NULL on error
+static inline fFMADRingCursor_t* FMADPacket_GroupAttach(fFMADRingHeader_t* RING, const u8* Name)
+{
+	if (RING->Version != FMADRING_VERSION)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR work-sharing group [%s] requires a fixed slot ring\n", RING->Path, Name);
+		return NULL;
+	}
+
+	for (int Retry=0; Retry < 1000; Retry++)
+	{
+		// existing group
+		bool IsBusy = false;
+		for (int i=1; i < FMADRING_CURSOR_MAX; i++)
+		{
+			fFMADRingCursor_t* Cur = &RING->Cursor[i];
+			if (strncmp((char*)Cur->Name, (const char*)Name, sizeof(Cur->Name)) != 0) continue;
+
+			if (Cur->Flag == 0) break;
+
+			// group being created or torn down
+			IsBusy = true;
+			if ((Cur->Flag & FMADRING_CURSOR_FLAG_GROUP) == 0) break;
+
+			u32 Members = Cur->Members;
+			if (Members == 0) break;
+			if (!__sync_bool_compare_and_swap(&Cur->Members, Members, Members + 1)) break;
+
+			// liveness of a single process only
+			if (Cur->PID != getpid()) Cur->PID = 0;
+
+			fprintf(stderr, "RING[%-50s] group %i [%s] joined members %i\n", RING->Path, i, Name, Members + 1);
+			return Cur;
+		}
+		if (IsBusy)
+		{
+			usleep(100);
+			continue;
+		}
+
+		// first member 
+		fFMADRingCursor_t* C = FMADPacket_CursorAttach(RING, Name);
+		if (C == NULL) return NULL;
+
+		C->Claim	= C->Get;
+		C->Members	= 1;
+
+		sfence();
+		__sync_fetch_and_or(&C->Flag, FMADRING_CURSOR_FLAG_GROUP);
+
+		return C;
+	}
+
+	fprintf(stderr, "RING[%-50s] ERROR [%s] is not a work-sharing group\n", RING->Path, Name);
+	return NULL;
+}
+
+//---------------------------------------------------------------------------------------------
+// leave a group, the last member detaches the cursor 
+static inline void FMADPacket_GroupDetach(fFMADRingHeader_t* RING, fFMADRingCursor_t* C)
+{
+	if (__sync_sub_and_fetch(&C->Members, 1) == 0)
+	{
+		FMADPacket_CursorDetach(RING, C);
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// open and map an existing ring read/write for a reader
+// returns the ring, NULL on error
+static inline fFMADRingHeader_t* FMADPacket_OpenRxMap(int* pfd, u8* Path)
+{
+	int fd = 0;	
+
+	fd  = open64((char*)Path,  O_RDWR, S_IRWXU | S_IRWXG | 0777);	
+	if (fd < 0)
+	{
+		fprintf(stderr, "RING[%-50s] failed to create FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
+		return NULL;
+	}
+
+	// map it
+	fFMADRingHeader_t* RING = FMADPacket_MapExisting(fd, false, Path);
+	if (RING == NULL)
+	{
+		fprintf(stderr, "RING[%-50s] failed to map RING\n", Path);
+		close(fd);
+		return NULL;	
+	}
+
+	pfd[0] = fd;
+	return RING;
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for rx as a named reader. Name NULL or empty uses the default reader
+static inline int FMADPacket_OpenRxCursor(	int* 					pfd, 
+											fFMADRingHeader_t** 	pRing, 
+											fFMADRingCursor_t**		pCursor,
+											u8* 					Path,
+											const u8*				Name
+){
+	int fd = 0;	
+
+	fFMADRingHeader_t* RING = FMADPacket_OpenRxMap(&fd, Path);
+	if (RING == NULL) return -1;
+
+	fFMADRingCursor_t* C = &RING->Cursor[0];
+	if ((Name != NULL) && (Name[0] != 0))
+	{
+		C = FMADPacket_CursorAttach(RING, Name);
+		if (C == NULL)
+		{
+			munmap(RING, FMADPacket_MapSize(RING));
+			close(fd);
+			return -1;
+		}
+	}
+	else
+	{
+		// default reader starts at the current write pointer 
+		FMADPacket_CursorExpire(RING);
+		if (C->Flag & FMADRING_CURSOR_FLAG_ACTIVE)
+		{
+			fprintf(stderr, "RING[%-50s] WARNING default reader already attached pid %i, use a named reader\n", Path, C->PID);
+		}
+		FMADPacket_CursorStart(RING, C);
+	}
+
+	fprintf(stderr, "RING[%-50s] Path:%s\n", Path, RING->Path);
+	fprintf(stderr, "RING[%-50s] Put:%llx %llx\n", Path, RING->Put, RING->Put & RING->Mask);
+	fprintf(stderr, "RING[%-50s] Get:%llx %llx\n", Path, C->Get, C->Get & RING->Mask);
+
+	// update files
+	if (pfd) 		pfd[0] 		= fd;
+	if (pRing) 		pRing[0] 	= RING;
+	if (pCursor)	pCursor[0]	= C;
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for rx 
+static inline int FMADPacket_OpenRx(	int* 				pfd, 
+										fFMADRingHeader_t** pRing, 
+										bool 				IsWait, 
+										u8* 				Path
+){
+	return FMADPacket_OpenRxCursor(pfd, pRing, NULL, Path, NULL);
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for monitoring only (read only) 
+static inline int FMADPacket_OpenMon(	int* 				pfd, 
+										fFMADRingHeader_t** pRing, 
+										u8* 				Path
+){
+	int fd = 0;	
+
+	fd  = open64((char*)Path,  O_RDONLY, S_IRWXU | S_IRWXG | 0777);	
+	if (fd < 0)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR failed to open FMADRing file errno:%i %s\n",  Path, errno, strerror(errno));
+		return -1;
+	}
+
+	// map it
+	fFMADRingHeader_t* RING = FMADPacket_MapExisting(fd, true, Path);
+	if (RING == NULL)
+	{
+		fprintf(stderr, "RING[%-50s] ERROR failed to map RING (read only)\n", Path);
+		close(fd);
+		return -1;	
+	}
+
+	fprintf(stderr, "RING[%-50s] Status GOOD\n", Path);
+
+	// update files
+	if (pfd) 	pfd[0] 		= fd;
+	if (pRing) 	pRing[0] 	= RING;
+
+	return 0;
+}
+
+
+//---------------------------------------------------------------------------------------------
+// murmur3 64b finalizer
+static inline u64 FMADPacket_HashMix(u64 h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// order independent hash of two endpoints
+static inline u64 FMADPacket_HashPair(u64 A, u64 B, u64 Proto)
+{
+	u64 Lo = (A < B) ? A : B;
+	u64 Hi = (A < B) ? B : A;
+	return FMADPacket_HashMix(Lo ^ FMADPacket_HashMix(Hi ^ FMADPacket_HashMix(Proto)));
+}
+
+static inline u16 FMADPacket_Load16(const u8* p) { return ((u16)p[0] << 8) | p[1]; }
+static inline u32 FMADPacket_Load32(const u8* p) { return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3]; }
+static inline u64 FMADPacket_Load64(const u8* p) { return ((u64)FMADPacket_Load32(p) << 32) | FMADPacket_Load32(p + 4); }
+
+//---------------------------------------------------------------------------------------------
+// parse the headers of an ethernet frame once. vlan/qinq tags and mpls labels are skipped, IP
+// under mpls is found by the version nibble. the flow hash is symmetric, IPv4/IPv6 hash the 
+// addresses, protocol and the TCP/UDP/SCTP ports. fragments and IPv6 extension headers hash 
+// without ports so every piece of a flow goes the same way. non IP hashes the mac addresses
+static inline u64 FMADPacket_MetaParse(fFMADRingMeta_t* Meta, const void* Payload, u32 Length)
+{
+	const u8* Pkt = (const u8*)Payload;
+
+	memset(Meta, 0, sizeof(fFMADRingMeta_t));
+	if (Length < 14) return 0;
+
+	u32 Offset		= 14;
+	u16 EtherType	= FMADPacket_Load16(Pkt + 12);
+
+	// vlan / qinq
+	while ((Meta->VLANCnt < 2) && ((EtherType == 0x8100) || (EtherType == 0x88a8) || (EtherType == 0x9100)))
+	{
+		if (Offset + 4 > Length)
+		{
+			Meta->Flag	|= FMADRING_META_TRUNC;
+			break;
+		}
+		EtherType		= FMADPacket_Load16(Pkt + Offset + 2);
+		Offset			+= 4;
+		Meta->VLANCnt++;
+	}
+
+	// mpls label stack up to the bottom of stack bit
+	if ((EtherType == 0x8847) || (EtherType == 0x8848))
+	{
+		bool IsBottom = false;
+		while (!IsBottom && (Meta->MPLSCnt < 8))
+		{
+			if (Offset + 4 > Length)
+			{
+				Meta->Flag	|= FMADRING_META_TRUNC;
+				break;
+			}
+			IsBottom		= (Pkt[Offset + 2] & 1) != 0;
+			Offset			+= 4;
+			Meta->MPLSCnt++;
+		}
+
+		// no ethertype under mpls, guess from the IP version
+		if (IsBottom && (Offset < Length))
+		{
+			if ((Pkt[Offset] >> 4) == 4) EtherType = 0x0800;
+			if ((Pkt[Offset] >> 4) == 6) EtherType = 0x86dd;
+		}
+	}
+
+	Meta->EtherType		= EtherType;
+	Meta->L3Offset		= Offset;
+	Meta->Flag			|= FMADRING_META_VALID;
+
+	u64 A		= 0;
+	u64 B		= 0;
+	u32 L4		= 0;			// layer 4 offset, 0 if unknown 
+
+	// IPv4
+	if ((EtherType == 0x0800) && (Offset + 20 <= Length))
+	{
+		const u8* IP	= Pkt + Offset;
+		u32 HeaderLen	= (IP[0] & 0xf) * 4;
+		u16 Frag		= FMADPacket_Load16(IP + 6);
+
+		Meta->IPProto	= IP[9];
+		A				= (u64)FMADPacket_Load32(IP + 12) << 16;
+		B				= (u64)FMADPacket_Load32(IP + 16) << 16;
+
+		// MF set or a non zero fragment offset. only the first fragment has the transport header
+		if ((Frag & 0x3fff) != 0)	Meta->Flag |= FMADRING_META_FRAG;
+		if ((Frag & 0x1fff) == 0)	L4 = Offset + HeaderLen;
+	}
+	// IPv6, addresses folded to 64b 
+	else if ((EtherType == 0x86dd) && (Offset + 40 <= Length))
+	{
+		const u8* IP = Pkt + Offset;
+
+		Meta->IPProto	= IP[6];
+		A				= FMADPacket_HashMix(FMADPacket_Load64(IP +  8) ^ FMADPacket_HashMix(FMADPacket_Load64(IP + 16))) << 16;
+		B				= FMADPacket_HashMix(FMADPacket_Load64(IP + 24) ^ FMADPacket_HashMix(FMADPacket_Load64(IP + 32))) << 16;
+
+		// extension headers are not walked
+		switch (Meta->IPProto)
+		{
+		case 0:
+		case 43:
+		case 51:
+		case 60:	break;
+		case 44:	Meta->Flag |= FMADRING_META_FRAG; break;
+		default:	L4 = Offset + 40; break;
+		}
+	}
+	else
+	{
+		if ((EtherType == 0x0800) || (EtherType == 0x86dd)) Meta->Flag |= FMADRING_META_TRUNC;
+
+		u64 SrcMAC = FMADPacket_Load64(Pkt + 4) & 0xffffffffffffULL;
+		u64 DstMAC = FMADPacket_Load64(Pkt + 0) >> 16;
+		u64 Hash	= FMADPacket_HashPair(SrcMAC, DstMAC, EtherType);
+
+		Meta->FlowHash = (u32)Hash;
+		return Hash;
+	}
+
+	// transport header and payload
+	u32 Proto = Meta->IPProto;
+	if (L4 != 0)
+	{
+		u32 L7 = 0;
+		if (Proto == 6)		L7 = (L4 + 13 <= Length) ? L4 + (Pkt[L4 + 12] >> 4) * 4 : L4 + 20;
+		if (Proto == 17)	L7 = L4 + 8;
+		if (Proto == 132)	L7 = L4 + 12;
+
+		if (L4 < Length)	Meta->L4Offset = L4;
+		else				Meta->Flag |= FMADRING_META_TRUNC;
+
+		if (L7 <= Length)	Meta->L7Offset = L7;
+		else				Meta->Flag |= FMADRING_META_TRUNC;
+	}
+
+	// ports 
+	if ((Meta->Flag & FMADRING_META_FRAG) == 0)
+	{
+		if ((L4 != 0) && (L4 + 4 <= Length) && ((Proto == 6) || (Proto == 17) || (Proto == 132)))
+		{
+			A |= FMADPacket_Load16(Pkt + L4 + 0);
+			B |= FMADPacket_Load16(Pkt + L4 + 2);
+		}
+	}
+
+	u64 Hash		= FMADPacket_HashPair(A, B, Proto);
+	Meta->FlowHash	= (u32)Hash;
+	return Hash;
+}
+
+// symmetric flow hash of an ethernet frame
+static inline u64 FMADPacket_FlowHash(const void* Payload, u32 Length)
+{
+	fFMADRingMeta_t Meta;
+	return FMADPacket_MetaParse(&Meta, Payload, Length);
+}
+
+//---------------------------------------------------------------------------------------------
+// fill a ring slot, caller publishes it. Meta is where the parsed headers go, NULL if the ring 
+// does not carry them
+static inline void FMADPacket_SlotWrite(	fFMADRingPacket_t* 	FPkt,
+											fFMADRingMeta_t*	Meta,
+											u64 				TS, 
+											u32 				LengthWire,
+											u32 				LengthCapture,
+											u32 				Port,
+											u32					Flag,
+											u64					StorageID,
+											const void*			Payload
+										)
+{
+	FPkt->TS				= TS;
+	FPkt->LengthWire		= LengthWire;
+	FPkt->LengthCapture		= LengthCapture;
+	FPkt->Port				= Port; 
+	FPkt->Flag				= Flag; 
+	FPkt->StorageID			= StorageID; 
+	memcpy(&FPkt->Payload[0], Payload, LengthCapture);
+
+	if (Meta) FMADPacket_MetaParse(Meta, Payload, LengthCapture);
+}
+
+//---------------------------------------------------------------------------------------------
+// a fixed slot ring without flow control lets the producer lap its readers. each slot is then 
+// stamped like a seqlock, Seq is cleared while the slot is re-written and set to its ring 
+// index + 1 after, along with the PutByte before it. a reader can tell its slot was overwritten
+// and count exactly what it lost. packed and MPSC rings drop on full instead. rings created 
+// without FMADRING_FEATURE_SEQ (older producers, FMADIO capture) are not stamped and not checked
+static inline bool FMADPacket_IsOverwrite(fFMADRingHeader_t* RING)
+{
+	return (RING->Version == FMADRING_VERSION) && (RING->Feature & FMADRING_FEATURE_SEQ);
+}
+
+// each side keeps a cached copy of the other sides position, FMADRING_FEATURE_NOCACHE 
+// turns it off to measure what it saves
+static inline bool FMADPacket_IsCache(fFMADRingHeader_t* RING)
+{
+	return (RING->Feature & FMADRING_FEATURE_NOCACHE) == 0;
+}
+
+// slot is about to be re-written. x86 keeps stores in order, only the compiler needs holding back
+static inline void FMADPacket_SlotSeqClear(fFMADRingPacket_t* FPkt)
+{
+	FPkt->Seq = 0;
+	__asm__ volatile("" ::: "memory");
+}
+
+// slot contents are complete
+static inline void FMADPacket_SlotSeqSet(fFMADRingPacket_t* FPkt, s64 Index, u64 Byte)
+{
+	__asm__ volatile("" ::: "memory");
+	FPkt->SeqByte	= Byte;
+	FPkt->Seq		= Index + 1;
+}
+
+//---------------------------------------------------------------------------------------------
+// count the rest of a burst dropped on a full ring 
+static inline void FMADPacket_SendDrop(	fFMADRingHeader_t* 			RING, 
+										const fFMADRingSendDesc_t*	Desc,
+										u32							DescCnt
+									)
+{
+	u64 Byte = 0;
+	for (int i=0; i < DescCnt; i++) Byte += Desc[i].LengthCapture;
+
+	__sync_fetch_and_add(&RING->PutDropPkt, DescCnt);
+	__sync_fetch_and_add(&RING->PutDropByte, Byte);
+}
+
+//---------------------------------------------------------------------------------------------
+// FMADRING_VERSION2 packed ring. packets are stored back to back in a byte ring as 
+// fFMADRingRecord_t + fFMADRingPacket_t header + payload, each record 64B aligned.
+// PutPos/GetPos are the byte offsets, Put/Get still count packets. a record never 
+// wraps, the tail of the ring is filled with a FMADRING_RECORD_FLAG_WRAP record instead.
+// a full ring without flow control drops the new packet, as records can not be overwritten
+
+// record at a byte ring offset 
+static inline fFMADRingRecord_t* FMADPacket_PackedRecord(fFMADRingHeader_t* RING, s64 Pos)
+{
+	return (fFMADRingRecord_t*)( ((u8*)RING->Packet) + (Pos & RING->DataMask) );
+}
+
+// record holding a packet 
+static inline fFMADRingRecord_t* FMADPacket_PackedRecordOf(const fFMADRingPacket_t* Pkt)
+{
+	return (fFMADRingRecord_t*)( ((u8*)Pkt) - sizeof(fFMADRingRecord_t) );
+}
+
+// packet of a record 
+static inline fFMADRingPacket_t* FMADPacket_PackedPacket(fFMADRingRecord_t* Rec)
+{
+	return (fFMADRingPacket_t*)(Rec + 1);
+}
+
+// metadata stored with a packet, in the slot or the packed record header. 
+// NULL if the ring was not created with FMADRING_FEATURE_META
+static inline fFMADRingMeta_t* FMADPacket_PacketMeta(fFMADRingHeader_t* RING, const fFMADRingPacket_t* Pkt)
+{
+	if ((RING->Feature & FMADRING_FEATURE_META) == 0) return NULL;
+
+	if (RING->Version == FMADRING_VERSION2) return &FMADPacket_PackedRecordOf(Pkt)->Meta;
+	return (fFMADRingMeta_t*)&Pkt->Meta;
+}
+
+// producer TSC stamp of a packet, in the slot or the packed record header. 
+// 0 if the ring was not created with FMADRING_FEATURE_LATENCY
+static inline u64 FMADPacket_PacketTSC(fFMADRingHeader_t* RING, const fFMADRingPacket_t* Pkt)
+{
+	if ((RING->Feature & FMADRING_FEATURE_LATENCY) == 0) return 0;
+
+	if (RING->Version == FMADRING_VERSION2) return FMADPacket_PackedRecordOf(Pkt)->PutTSC;
+	return Pkt->PutTSC;
+}
+
+// stamp for the packets of a send, 0 if the ring is not stamped
+static inline u64 FMADPacket_PutTSC(fFMADRingHeader_t* RING)
+{
+	return (RING->Feature & FMADRING_FEATURE_LATENCY) ? rdtsc() : 0;
+}
+
+// fixed slot stamp, packed records are stamped with the record header
+static inline void FMADPacket_PacketStamp(fFMADRingHeader_t* RING, fFMADRingPacket_t* Pkt, u64 PutTSC)
+{
+	if (RING->Feature & FMADRING_FEATURE_LATENCY) Pkt->PutTSC = PutTSC;
+}
+
+//---------------------------------------------------------------------------------------------
+// ring latency, from the producer writing a packet to a reader receiving it. HDR style 
+// histogram with FMADRING_LAT_SUB linear bins per power of 2, so a bin is within 25% 
+// of its value. exact below FMADRING_LAT_SUB nsec
+
+// bin of a latency
+static inline u32 FMADPacket_LatBin(u64 NS)
+{
+	if (NS < FMADRING_LAT_SUB) return NS;
+
+	u32 Exp = 63 - __builtin_clzll(NS);
+	u32 Bin = (Exp - FMADRING_LAT_SUBBIT + 1) * FMADRING_LAT_SUB + ((NS >> (Exp - FMADRING_LAT_SUBBIT)) & (FMADRING_LAT_SUB - 1));
+	return (Bin < FMADRING_LAT_HISTO) ? Bin : FMADRING_LAT_HISTO - 1;
+}
+
+// lowest latency of a bin
+static inline u64 FMADPacket_LatBinNS(u32 Bin)
+{
+	if (Bin < FMADRING_LAT_SUB) return Bin;
+
+	u32 Exp = Bin / FMADRING_LAT_SUB + FMADRING_LAT_SUBBIT - 1;
+	return (u64)(FMADRING_LAT_SUB + (Bin % FMADRING_LAT_SUB)) << (Exp - FMADRING_LAT_SUBBIT);
+}
+
+// reader received a batch of packets
+static inline void FMADPacket_StatLatency(fFMADRingHeader_t* RING, const fFMADRingPacket_t** Pkt, u32 PktCnt)
+{
+	if ((RING->Feature & FMADRING_FEATURE_LATENCY) == 0) return;
+	if (PktCnt == 0) return;
+
+	u64 Now = rdtsc();
+	u64 Sum = 0;
+	u64 Max = 0;
+	for (int i=0; i < PktCnt; i++)
+	{
+		s64 Cycle	= Now - FMADPacket_PacketTSC(RING, Pkt[i]);
+		u64 NS		= (Cycle > 0) ? tsc2ns(Cycle) : 0;
+
+		__sync_fetch_and_add(&RING->LatHisto[ FMADPacket_LatBin(NS) ], 1);
+		Sum += NS;
+		if (NS > Max) Max = NS;
+	}
+	__sync_fetch_and_add(&RING->LatCnt, PktCnt);
+	__sync_fetch_and_add(&RING->LatSum, Sum);
+
+	u64 Prev = RING->LatMax;
+	while ((Max > Prev) && !__sync_bool_compare_and_swap(&RING->LatMax, Prev, Max)) Prev = RING->LatMax;
+}
+
+// reader released a packet stamped PutTSC
+static inline void FMADPacket_StatLatencyTSC(fFMADRingHeader_t* RING, u64 PutTSC)
+{
+	if ((RING->Feature & FMADRING_FEATURE_LATENCY) == 0) return;
+
+	s64 Cycle	= rdtsc() - PutTSC;
+	u64 NS		= (Cycle > 0) ? tsc2ns(Cycle) : 0;
+
+	__sync_fetch_and_add(&RING->LatHisto[ FMADPacket_LatBin(NS) ], 1);
+	__sync_fetch_and_add(&RING->LatCnt, 1);
+	__sync_fetch_and_add(&RING->LatSum, NS);
+
+	u64 Prev = RING->LatMax;
+	while ((NS > Prev) && !__sync_bool_compare_and_swap(&RING->LatMax, Prev, NS)) Prev = RING->LatMax;
+}
+
+// latency at a percentile (0 - 100), the low end of its bin 
+static inline u64 FMADPacket_LatPercentile(fFMADRingHeader_t* RING, double Pct)
+{
+	u64 Total = 0;
+	for (int i=0; i < FMADRING_LAT_HISTO; i++) Total += RING->LatHisto[i];
+	if (Total == 0) return 0;
+
+	u64 Rank	= (u64)(Total * Pct / 100.0);
+	u64 Cnt		= 0;
+	for (int i=0; i < FMADRING_LAT_HISTO; i++)
+	{
+		Cnt += RING->LatHisto[i];
+		if (Cnt > Rank) return FMADPacket_LatBinNS(i);
+	}
+	return FMADPacket_LatBinNS(FMADRING_LAT_HISTO - 1);
+}
+
+// aligned record size for a packet 
+static inline u32 FMADPacket_PackedSize(u32 LengthCapture)
+{
+	u32 Size = sizeof(fFMADRingRecord_t) + FMADRING_PACKET_HDRSIZE + LengthCapture;
+	return (Size + FMADRING_PACKED_ALIGN - 1) & ~(FMADRING_PACKED_ALIGN - 1);
+}
+
+//---------------------------------------------------------------------------------------------
+// packed ring wait for space 
+// returns free bytes, 0 if full and no flow control, -1 if the consumer did not drain within TxTimeout
+static inline s64 FMADPacket_PackedSendWait(	fFMADRingHeader_t* 	RING, 
+												s64 				PutPos,
+												u32 				Need
+											)
+{
+	u64 TS0 = rdtsc();
+	u32 Loop = 0;
+	bool IsWaiter = false;
+	while (true)
+	{
+		u32 WakeSeq = RING->GetWake;
+
+		// slowest reader
+		s64 Free = RING->DataSize - (PutPos - FMADPacket_GetRefresh(RING, true));
+		if (Free >= Need)
+		{
+			FMADPacket_SendSleepEnd(RING, &IsWaiter);
+			if (Loop > 0) FMADPacket_StatSendStall(RING, TS0);
+			return Free;
+		}
+
+		// no flow control, drop 
+		if (!RING->IsTxFlowControl) return 0;
+
+		// dont wait on readers that have exited
+		if ((++Loop & 0xff) == 0) FMADPacket_CursorExpire(RING);
+
+		if (FMADPacket_SendSleep(RING, TS0, &IsWaiter, WakeSeq) < 0)
+		{
+			FMADPacket_SendSleepEnd(RING, &IsWaiter);
+			FMADPacket_StatSendStall(RING, TS0);
+			return -1;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// packed ring publish written records 
+static inline void FMADPacket_PackedPublish(	fFMADRingHeader_t* 	RING, 
+												s64					PutPos,
+												u32					PktCnt,
+												u64					Byte,
+												u64					LastTS
+											)
+{
+	if (PktCnt == 0) return;
+
+	sfence();
+
+	// byte offset is what the consumer polls 
+	s64 Put					= RING->Put;
+	RING->PutPos			= PutPos;
+	RING->Put 				= Put + PktCnt;
+	RING->PutByte 			+= Byte;
+	RING->PutPktTS 			= LastTS;
+
+	FMADPacket_PutNotify(RING);
+	FMADPacket_StatPublish(RING, Put, Put + PktCnt);
+}
+
+//---------------------------------------------------------------------------------------------
+// packed ring write a burst of packets 
+// returns number of packets written, less than DescCnt if the rest was dropped on a full ring
+// or the flow control timed out part way. -1 if it timed out before any were written
+static inline int FMADPacket_PackedSendBatch(	fFMADRingHeader_t* 			RING, 
+												const fFMADRingSendDesc_t*	Desc,
+												u32							DescCnt
+											)
+{
+	s64 PutPos	= RING->PutPos;
+	s64 GetPos	= FMADPacket_IsCache(RING) ? RING->GetPosCache : FMADPacket_GetRefresh(RING, true);
+	s64 Free	= RING->DataSize - (PutPos - GetPos);
+
+	// written but not yet published
+	u32 PktCnt	= 0;
+	u64 Byte	= 0;
+	u64 LastTS	= 0;
+	u64 PutTSC	= FMADPacket_PutTSC(RING);
+
+	u32 Pos = 0;
+	for (; Pos < DescCnt; Pos++)
+	{
+		const fFMADRingSendDesc_t* D = &Desc[Pos];
+
+		// pad to the start of the ring if the record does not fit in the tail
+		u32 Size	= FMADPacket_PackedSize(D->LengthCapture);
+		s64 Tail	= RING->DataSize - (PutPos & RING->DataMask);
+		s64 Pad		= (Tail < Size) ? Tail : 0;
+
+		if (Free < Pad + Size)
+		{
+			// let the consumer drain what has been written so far
+			FMADPacket_PackedPublish(RING, PutPos, PktCnt, Byte, LastTS);
+			PktCnt	= 0;
+			Byte	= 0;
+
+			Free = FMADPacket_PackedSendWait(RING, PutPos, Pad + Size);
+			if (Free < 0) return (Pos > 0) ? Pos : -1;
+
+			PutTSC = FMADPacket_PutTSC(RING);
+
+			// full, drop the rest of the burst
+			if (Free == 0)
+			{
+				FMADPacket_SendDrop(RING, &Desc[Pos], DescCnt - Pos);
+				break;
+			}
+		}
+
+		if (Pad > 0)
+		{
+			fFMADRingRecord_t* Rec 	= FMADPacket_PackedRecord(RING, PutPos);
+			Rec->Size				= Pad;
+			Rec->Flag				= FMADRING_RECORD_FLAG_WRAP;
+			PutPos 					+= Pad;
+		}
+
+		fFMADRingRecord_t* Rec 	= FMADPacket_PackedRecord(RING, PutPos);
+		Rec->Size				= Size;
+		Rec->Flag				= 0;
+		Rec->PutTSC				= PutTSC;
+		FMADPacket_SlotWrite(FMADPacket_PackedPacket(Rec), (RING->Feature & FMADRING_FEATURE_META) ? &Rec->Meta : NULL, D->TS, D->LengthWire, D->LengthCapture, D->Port, D->Flag, D->StorageID, D->Payload);
+
+		PutPos 	+= Size;
+		Free	-= Pad + Size;
+
+		PktCnt	+= 1;
+		Byte	+= D->LengthCapture;
+		LastTS	= D->TS;
+	}
+
+	FMADPacket_PackedPublish(RING, PutPos, PktCnt, Byte, LastTS);
+
+	return Pos;
+}
+
+//---------------------------------------------------------------------------------------------
+// FMADRING_FEATURE_MPSC multiple producers. each producer reserves slots by advancing 
+// PutReserve, fills them and stamps the slots Seq with its ring index + 1 as the commit flag.
+// Put is then advanced over the contiguous run of committed slots by whichever producer gets
+// there, so the consumer only ever sees fully written entries and its side is unchanged.
+// a full ring without flow control drops, slots reserved by another producer can not be overwritten
+
+// advance Put over committed slots 
+static inline void FMADPacket_MPPublish(fFMADRingHeader_t* RING)
+{
+	while (true)
+	{
+		s64 Put		= RING->Put;
+		s64 Reserve	= RING->PutReserve;
+
+		s64 End = Put;
+		while ((End < Reserve) && (RING->Packet[ End & RING->Mask ].Seq == End + 1)) End++;
+
+		// next slot is still being written, its producer publishes it
+		if (End == Put) return;
+
+		if (__sync_bool_compare_and_swap(&RING->Put, Put, End))
+		{
+			FMADPacket_PutNotify(RING);
+			FMADPacket_StatPublish(RING, Put, End);
+			return;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// multiple producer write a burst of packets 
+// returns number of packets written, less than DescCnt if the rest was dropped on a full ring
+// or the flow control timed out part way. -1 if it timed out before any were written
+static inline int FMADPacket_MPSendBatch(	fFMADRingHeader_t* 			RING, 
+											const fFMADRingSendDesc_t*	Desc,
+											u32							DescCnt
+										)
+{
+	u64 TS0 	= 0;
+	u32 Loop 	= 0;
+	bool IsWaiter = false;
+
+	u32 Pos = 0;
+	while (Pos < DescCnt)
+	{
+		u32 WakeSeq = RING->GetWake;
+
+		// reserve against the slowest reader
+		s64 Start	= RING->PutReserve;
+		s64 Free	= (RING->Depth - 1) - (Start - RING->GetCache);
+		if ((Free <= 0) || !FMADPacket_IsCache(RING)) Free = (RING->Depth - 1) - (Start - FMADPacket_GetRefresh(RING, false));
+		if (Free <= 0)
+		{
+			// full, drop the rest of the burst
+			if (!RING->IsTxFlowControl)
+			{
+				FMADPacket_SendDrop(RING, &Desc[Pos], DescCnt - Pos);
+				break;
+			}
+
+			if (TS0 == 0) TS0 = rdtsc();
+
+			// dont wait on readers that have exited
+			if ((++Loop & 0xff) == 0) FMADPacket_CursorExpire(RING);
+
+			if (FMADPacket_SendSleep(RING, TS0, &IsWaiter, WakeSeq) < 0)
+			{
+				FMADPacket_SendSleepEnd(RING, &IsWaiter);
+				FMADPacket_StatSendStall(RING, TS0);
+				return (Pos > 0) ? Pos : -1;
+			}
+			continue;
+		}
+		FMADPacket_SendSleepEnd(RING, &IsWaiter);
+
+		if (TS0 != 0)
+		{
+			FMADPacket_StatSendStall(RING, TS0);
+			TS0 = 0;
+		}
+
+		u32 Cnt = DescCnt - Pos;
+		if (Cnt > Free) Cnt = Free;
+
+		// another producer got there first
+		if (!__sync_bool_compare_and_swap(&RING->PutReserve, Start, Start + Cnt)) continue;
+
+		// fill and commit
+		u64 Byte	= 0;
+		u64 PutTSC	= FMADPacket_PutTSC(RING);
+		for (int i=0; i < Cnt; i++)
+		{
+			const fFMADRingSendDesc_t* D = &Desc[Pos + i];
+			fFMADRingPacket_t* FPkt = &RING->Packet[ (Start + i) & RING->Mask ];
+
+			FMADPacket_SlotWrite(FPkt, FMADPacket_PacketMeta(RING, FPkt), D->TS, D->LengthWire, D->LengthCapture, D->Port, D->Flag, D->StorageID, D->Payload);
+			FMADPacket_PacketStamp(RING, FPkt, PutTSC);
+			Byte += D->LengthCapture;
+
+			// slot contents before the commit stamp
+			__asm__ volatile("" ::: "memory");
+			FPkt->Seq = Start + i + 1;
+		}
+
+		__sync_fetch_and_add(&RING->PutByte, Byte);
+		RING->PutPktTS = Desc[Pos + Cnt - 1].TS;
+
+		// commit stamps must be visible before looking at the other producers slots
+		mfence();
+
+		FMADPacket_MPPublish(RING);
+
+		Pos += Cnt;
+	}
+
+	return Pos;
+}
+
+//---------------------------------------------------------------------------------------------
+// wait for space on the tx side 
+// returns number of free slots up to Count, or -1 if the consumer did not drain within TxTimeout
+static inline s64 FMADPacket_SendWait(	fFMADRingHeader_t* 	RING, 
+										u32 				Count
+									)
+{
+	// no flow control, always space
+	if (!RING->IsTxFlowControl) return Count;
+
+	// cached headroom, the readers cursors are not touched
+	s64 Free = (RING->Depth - 1) - (RING->Put - RING->GetCache);
+	if ((Free > 0) && FMADPacket_IsCache(RING)) return (Free < Count) ? Free : Count;
+
+	u64 TS0 = rdtsc();
+	u32 Loop = 0;
+	bool IsWaiter = false;
+	while (true)
+	{
+		u32 WakeSeq = RING->GetWake;
+
+		// slowest reader
+		s64 dQueue = RING->Put - FMADPacket_GetRefresh(RING, false);
+		Free = (RING->Depth - 1) - dQueue;
+		if (Free > 0)
+		{
+			FMADPacket_SendSleepEnd(RING, &IsWaiter);
+			if (Loop > 0) FMADPacket_StatSendStall(RING, TS0);
+			return (Free < Count) ? Free : Count;
+		}
+
+		// dont wait on readers that have exited
+		if ((++Loop & 0xff) == 0) FMADPacket_CursorExpire(RING);
+
+		if (FMADPacket_SendSleep(RING, TS0, &IsWaiter, WakeSeq) < 0)
+		{
+			FMADPacket_SendSleepEnd(RING, &IsWaiter);
+			FMADPacket_StatSendStall(RING, TS0);
+			return -1;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// write packet 
+static inline int FMADPacket_SendV1(	fFMADRingHeader_t* 	RING, 
+										u64 				TS, 
+										u32 				LengthWire,
+										u32 				LengthCapture,
+										u32 				Port,
+										u32					Flag,
+										u64					StorageID,
+										void*	 			Payload
+									)
+{
+	// packed ring
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		fFMADRingSendDesc_t D = { TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload };
+
+		int ret = FMADPacket_PackedSendBatch(RING, &D, 1);
+		if (ret <= 0) return ret;
+
+		return LengthCapture;
+	}
+
+	// multiple producers
+	if (RING->Feature & FMADRING_FEATURE_MPSC)
+	{
+		fFMADRingSendDesc_t D = { TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload };
+
+		int ret = FMADPacket_MPSendBatch(RING, &D, 1);
+		if (ret <= 0) return ret;
+
+		return LengthCapture;
+	}
+
+	// wait for space 
+	if (FMADPacket_SendWait(RING, 1) < 0) return -1;
+
+	// write packet
+	fFMADRingPacket_t* FPkt = &RING->Packet[ RING->Put & RING->Mask ];
+	bool IsOverwrite = FMADPacket_IsOverwrite(RING);
+
+	if (IsOverwrite) FMADPacket_SlotSeqClear(FPkt);
+	FMADPacket_SlotWrite(FPkt, FMADPacket_PacketMeta(RING, FPkt), TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload);
+	FMADPacket_PacketStamp(RING, FPkt, FMADPacket_PutTSC(RING));
+	if (IsOverwrite) FMADPacket_SlotSeqSet(FPkt, RING->Put, RING->PutByte);
+
+	sfence();
+
+	// publish 
+	s64 Put					= RING->Put;
+	RING->Put 				= Put + 1;
+	RING->PutByte 			+= LengthCapture;
+	RING->PutPktTS 			= TS;
+
+	FMADPacket_PutNotify(RING);
+	FMADPacket_StatPublish(RING, Put, Put + 1);
+
+	return LengthCapture;
+}
+
+//---------------------------------------------------------------------------------------------
+// write a burst of packets. slots are reserved against a single read of Get, filled, 
+// fenced once and published with a single Put/PutByte/PutPktTS update. bursts larger than 
+// the free space are split as the consumer drains
+//
+// returns number of packets written, less than DescCnt if the flow control timed out part way
+// through. -1 if it timed out before any were written
+static inline int FMADPacket_SendBatch(	fFMADRingHeader_t* 			RING, 
+										const fFMADRingSendDesc_t*	Desc,
+										u32							DescCnt
+									)
+{
+	// packed ring
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		return FMADPacket_PackedSendBatch(RING, Desc, DescCnt);
+	}
+
+	// multiple producers
+	if (RING->Feature & FMADRING_FEATURE_MPSC)
+	{
+		return FMADPacket_MPSendBatch(RING, Desc, DescCnt);
+	}
+
+	bool IsOverwrite = FMADPacket_IsOverwrite(RING);
+
+	u32 Pos = 0;
+	while (Pos < DescCnt)
+	{
+		// reserve 
+		s64 Free = FMADPacket_SendWait(RING, DescCnt - Pos);
+		if (Free < 0) return (Pos > 0) ? Pos : -1;
+
+		// fill
+		s64 Put 	= RING->Put;
+		u64 Byte 	= 0;
+		u64 PutTSC	= FMADPacket_PutTSC(RING);
+		for (int i=0; i < Free; i++)
+		{
+			const fFMADRingSendDesc_t* D = &Desc[Pos + i];
+			fFMADRingPacket_t* FPkt = &RING->Packet[ (Put + i) & RING->Mask ];
+
+			if (IsOverwrite) FMADPacket_SlotSeqClear(FPkt);
+			FMADPacket_SlotWrite(FPkt, FMADPacket_PacketMeta(RING, FPkt), D->TS, D->LengthWire, D->LengthCapture, D->Port, D->Flag, D->StorageID, D->Payload);
+			FMADPacket_PacketStamp(RING, FPkt, PutTSC);
+			if (IsOverwrite) FMADPacket_SlotSeqSet(FPkt, Put + i, RING->PutByte + Byte);
+
+			Byte += D->LengthCapture;
+		}
+
+		sfence();
+
+		// publish 
+		RING->Put 				= Put + Free;
+		RING->PutByte 			+= Byte;
+		RING->PutPktTS 			= Desc[Pos + Free - 1].TS;
+
+		FMADPacket_PutNotify(RING);
+		FMADPacket_StatPublish(RING, Put, Put + Free);
+
+		Pos += Free;
+	}
+
+	return DescCnt;
+}
+
+//---------------------------------------------------------------------------------------------
+// send EOF marker 
+static inline int FMADPacket_SendEOFV1(	fFMADRingHeader_t* 	RING, u64 TS)
+{
+	// packed ring
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		fFMADRingSendDesc_t D = { TS, 0, 0, 0, FMADRING_FLAG_EOF, 0, &TS };
+
+		if (FMADPacket_PackedSendBatch(RING, &D, 1) < 0) return -1;
+		return 0;
+	}
+
+	// multiple producers
+	if (RING->Feature & FMADRING_FEATURE_MPSC)
+	{
+		fFMADRingSendDesc_t D = { TS, 0, 0, 0, FMADRING_FLAG_EOF, 0, &TS };
+
+		if (FMADPacket_MPSendBatch(RING, &D, 1) < 0) return -1;
+		return 0;
+	}
+
+	// wait for space 
+	if (FMADPacket_SendWait(RING, 1) < 0) return -1;
+
+	// write packet
 	fFMADRingPacket_t* FPkt = &RING->Packet[ RING->Put & RING->Mask ];
+	bool IsOverwrite = FMADPacket_IsOverwrite(RING);
+
+	if (IsOverwrite) FMADPacket_SlotSeqClear(FPkt);
 	FPkt->TS				= TS;
 	FPkt->LengthWire		= 0;
 	FPkt->LengthCapture		= 0;
 	FPkt->Port				= 0; 
 	FPkt->Flag				= FMADRING_FLAG_EOF; 
+	FPkt->Meta.Flag			= 0;
+	if (IsOverwrite) FMADPacket_SlotSeqSet(FPkt, RING->Put, RING->PutByte);
 
 	sfence();
 
 	// publish 
-	RING->Put 				+= 1;
+	s64 Put					= RING->Put;
+	RING->Put 				= Put + 1;
 	RING->PutPktTS			= TS;
 
+	FMADPacket_PutNotify(RING);
+	FMADPacket_StatPublish(RING, Put, Put + 1);
+
 	return 0; 
 }
 
 //---------------------------------------------------------------------------------------------
-// get a packet non-zero copy way but simple interface 
-static inline int FMADPacket_RecvV1a(	fFMADRingHeader_t* RING, 
-										bool IsWait,
-										u64*		pTS,	
-										u32*		pLengthWire,	
-										u32*		pLengthCapture,	
-										u32*		pPort,	
-										u32*		pFlag,	
-										u64*		pStorageID,	
-										void*		Payload	
-										) 
+// idle reader, sleep until the producer publishes past the cursor or TimeoutNS passes
+// rings without FMADRING_FEATURE_FUTEX yield the thread with usleep(0) instead 
+static inline void FMADPacket_RecvIdle(	fFMADRingHeader_t* 	RING, 
+										fFMADRingCursor_t*	C,
+										u64					TimeoutNS
+									)
+{
+	if ((RING->Feature & FMADRING_FEATURE_FUTEX) == 0)
+	{
+		usleep(0);
+		return;
+	}
+
+	// register then re-check so a publish in between is not missed
+	__sync_fetch_and_add(&RING->PutWaiter, 1);
+	u32 WakeSeq = RING->PutWake;
+
+	bool IsEmpty = false;
+	if (RING->Version == FMADRING_VERSION2)					IsEmpty = (RING->PutPos == C->GetPos);
+	else if (C->Flag & FMADRING_CURSOR_FLAG_GROUP)			IsEmpty = (RING->Put == C->Claim);
+	else													IsEmpty = (RING->Put == C->Get);
+
+	if (IsEmpty) FMADPacket_FutexWait(&RING->PutWake, WakeSeq, TimeoutNS);
+
+	__sync_fetch_and_sub(&RING->PutWaiter, 1);
+}
+
+// non-blocking readers idle path, the time is counted as a stall on an empty ring 
+static inline void FMADPacket_RecvSleep(	fFMADRingHeader_t* 	RING, 
+											fFMADRingCursor_t*	C,
+											u64					TimeoutNS
+										)
+{
+	u64 TS0 = rdtsc();
+	FMADPacket_RecvIdle(RING, C, TimeoutNS);
+	FMADPacket_StatRecvStall(RING, TS0);
+}
+
+//---------------------------------------------------------------------------------------------
+// reader lapped by a producer without flow control. its next slot no longer holds the packet
+// it expects, skip to the oldest slot still intact and count the packets and bytes in between
+// as lost. returns 1 if it skipped, 0 if its slot is intact and -1 if no intact slot was found,
+// either the producer keeps lapping it or the slot is not stamped. the caller retries later
+static inline int FMADPacket_RecvOverrun(	fFMADRingHeader_t* 	RING, 
+											fFMADRingCursor_t*	C
+										)
+{
+	if (RING->Packet[ C->Get & RING->Mask ].Seq == C->Get + 1) return 0;
+
+	for (int Retry=0; Retry < FMADRING_OVERRUN_RETRY; Retry++)
+	{
+		// slot Put is the one being written 
+		s64 Put = RING->Put;
+		s64 Get = Put - (RING->Depth - 1);
+
+		// producer has not lapped it, the slot was never stamped
+		if (Get <= C->Get) return -1;
+
+		// read its byte offset seqlock style, retry if the producer laps it meanwhile
+		fFMADRingPacket_t* Pkt = &RING->Packet[ Get & RING->Mask ];
+		if (Pkt->Seq != Get + 1) continue;
+		u64 Byte = Pkt->SeqByte;
+		__asm__ volatile("" ::: "memory");
+		if (Pkt->Seq != Get + 1) continue;
+
+		C->LostPkt 		+= Get - C->Get;
+		C->LostByte 	+= Byte - C->GetByte;
+
+		C->Get			= Get;
+		C->GetByte		= Byte;
+		C->PutCache		= Put;
+
+		return 1;
+	}
+	return -1;
+}
+
+//---------------------------------------------------------------------------------------------
+// wait until every producer refresh of the cached slowest reader that started before now has
+// finished. a refresh started after this sees every cursor already attached. a producer that
+// stalls mid refresh for longer than TimeoutNS is reported and not waited on
+static inline void FMADPacket_GetRefreshWait(fFMADRingHeader_t* RING, u64 TimeoutNS)
+{
+	u64 Start 	= RING->GetRefreshStart;
+	u64 TS0		= rdtsc();
+	u32 Backoff	= 0;
+	while (true)
+	{
+		// End read first, if Start has not moved past it nothing was in flight at that point
+		u64 End = RING->GetRefreshEnd;
+		__asm__ volatile("" ::: "memory");
+		if ((End >= Start) && (End == RING->GetRefreshStart)) break;
+
+		if (tsc2ns(rdtsc() - TS0) > TimeoutNS)
+		{
+			fprintf(stderr, "RING[%-50s] WARNING producer refresh in flight for %.3f sec, not waiting on it\n", RING->Path, TimeoutNS / 1e9);
+			break;
+		}
+
+		__asm__ volatile("pause");
+		if (++Backoff > 1000)
+		{
+			Backoff = 0;
+			usleep(0);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// lower the producers cached slowest reader to Get. it then holds back for a reader that 
+// attached after its last refresh, once a refresh in flight has been waited out
+static inline void FMADPacket_GetLower(fFMADRingHeader_t* RING, bool IsPacked, s64 Get)
+{
+	while (true)
+	{
+		s64 Cur = IsPacked ? RING->GetPosCache : RING->GetCache;
+		if (Cur <= Get) break;
+
+		if (IsPacked)
+		{
+			if (__sync_bool_compare_and_swap(&RING->GetPosCache, Cur, Get)) break;
+		}
+		else
+		{
+			if (__sync_bool_compare_and_swap(&RING->GetCache, Cur, Get)) break;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// resume a claimed cursor from its persisted position instead of the write pointer, so a 
+// restarted reader picks up what was queued while it was away. once attached the producer 
+// holds back for it, except for a burst already in flight which was sized against its old 
+// cached slowest reader. packets older than that may have been overwritten while the reader
+// was detached, they are skipped and counted as lost. a ring without flow control checks 
+// the slot stamps instead. a packed ring position that does not walk to Put is not valid, 
+// it restarts at Put with everything in between counted as lost
+// returns the number of packets backlogged, pLostPkt the packets skipped
+static inline s64 FMADPacket_CursorResume(fFMADRingHeader_t* RING, fFMADRingCursor_t* C, u64* pLostPkt)
+{
+	u32 Index		= C - RING->Cursor;
+	bool IsPacked	= (RING->Version == FMADRING_VERSION2);
+	u64 LostPkt		= C->LostPkt;
+
+	if (pLostPkt) pLostPkt[0] = 0;
+
+	// position is not from this ring
+	if (IsPacked ? (C->GetPos > RING->PutPos) : (C->Get > RING->Put))
+	{
+		fprintf(stderr, "RING[%-50s] reader %i [%s] Get:%llx past Put:%llx, starting at Put\n", RING->Path, Index, C->Name, C->Get, RING->Put);
+		FMADPacket_CursorStart(RING, C);
+		return 0;
+	}
+
+	s64 GetCache	= IsPacked ? RING->GetPosCache : RING->GetCache;
+
+	C->PID		= getpid();
+
+	sfence();
+
+	C->Flag		= FMADRING_CURSOR_FLAG_ACTIVE;
+	__sync_fetch_and_or(&RING->CursorMask, 1U << Index);
+
+	// a refresh that read the cursors before this one was active could still store a cached
+	// slowest reader past it. the mask update is locked so any refresh started after it 
+	// sees the cursor, wait for the ones started before to finish then lower the cache
+	FMADPacket_GetRefreshWait(RING, FMADRING_RESUME_TIMEOUT);
+	FMADPacket_GetLower(RING, IsPacked, IsPacked ? C->GetPos : C->Get);
+
+	s64 Put		= RING->Put;
+	u64 PutByte	= RING->PutByte;
+
+	if (IsPacked)
+	{
+		// oldest byte a burst in flight can not reach
+		s64 PutPos	= RING->PutPos;
+		s64 Oldest	= PutPos - RING->DataSize + FMADRING_BATCH_MAX * sizeof(fFMADRingPacket_t);
+		if (Oldest > GetCache)					Oldest = GetCache;
+		if (Oldest < PutPos - RING->DataSize)	Oldest = PutPos - RING->DataSize;
+
+		// records can not be found from an arbitrary offset, restart at the old cached 
+		// slowest reader which is always a record boundary 
+		if (C->GetPos < Oldest)
+		{
+			u64 Cnt		= 0;
+			u64 Byte	= 0;
+			bool IsValid= true;
+			for (s64 Pos = GetCache; Pos < PutPos; )
+			{
+				fFMADRingRecord_t* Rec = FMADPacket_PackedRecord(RING, Pos);
+
+				// zeroed or torn record, the walk can not continue
+				if ((Rec->Size == 0) || (Rec->Size & (FMADRING_PACKED_ALIGN - 1)) || (Pos + Rec->Size > PutPos))
+				{
+					IsValid = false;
+					break;
+				}
+
+				if ((Rec->Flag & FMADRING_RECORD_FLAG_WRAP) == 0)
+				{
+					Cnt++;
+					Byte += FMADPacket_PackedPacket(Rec)->LengthCapture;
+				}
+				Pos += Rec->Size;
+			}
+
+			// cursor invalid, restart at Put 
+			if (!IsValid)
+			{
+				fprintf(stderr, "RING[%-50s] reader %i [%s] GetPos:%llx does not walk to PutPos:%llx, starting at Put\n", RING->Path, Index, C->Name, GetCache, PutPos);
+				GetCache	= PutPos;
+				Cnt			= 0;
+				Byte		= 0;
+			}
+
+			// counters are only approximate if the producer publishes meanwhile 
+			if (Put - (s64)Cnt < C->Get)		Cnt  = Put - C->Get;
+			if (PutByte - Byte < C->GetByte)	Byte = PutByte - C->GetByte;
+
+			C->LostPkt		+= (Put - Cnt) - C->Get;
+			C->LostByte		+= (PutByte - Byte) - C->GetByte;
+
+			C->GetPos		= GetCache;
+			C->Get			= Put - Cnt;
+			C->GetByte		= PutByte - Byte;
+		}
+	}
+	else if (FMADPacket_IsOverwrite(RING))
+	{
+		if (C->Get < Put) FMADPacket_RecvOverrun(RING, C);
+	}
+	else
+	{
+		// oldest slot a burst in flight can not reach
+		s64 Oldest	= Put - (RING->Depth - 1) + FMADRING_BATCH_MAX;
+		if (Oldest > GetCache)					Oldest = GetCache;
+		if (Oldest < Put - (RING->Depth - 1))	Oldest = Put - (RING->Depth - 1);
+
+		if (C->Get < Oldest)
+		{
+			u64 Byte = 0;
+			for (s64 i = Oldest; i < Put; i++) Byte += RING->Packet[ i & RING->Mask ].LengthCapture;
+			if (PutByte - Byte < C->GetByte) Byte = PutByte - C->GetByte;
+
+			C->LostPkt		+= Oldest - C->Get;
+			C->LostByte		+= (PutByte - Byte) - C->GetByte;
+
+			C->Get			= Oldest;
+			C->GetByte		= PutByte - Byte;
+		}
+	}
+
+	C->PutCache		= C->Get;
+	C->PutPosCache	= C->GetPos;
+
+	// producer may be waiting on the old position
+	FMADPacket_GetNotify(RING);
+
+	if (pLostPkt) pLostPkt[0] = C->LostPkt - LostPkt;
+
+	return Put - C->Get;
+}
+
+//---------------------------------------------------------------------------------------------
+// open fmad packet ring for rx resuming a reader where it left off, see FMADPacket_CursorResume.
+// Name NULL or empty resumes the default reader. a named reader that has not attached before
+// starts at the current write pointer. pBacklogPkt and pLostPkt are the packets queued for the 
+// reader and the packets lost since it was last attached
+static inline int FMADPacket_OpenRxResume(	int* 					pfd, 
+											fFMADRingHeader_t** 	pRing, 
+											fFMADRingCursor_t**		pCursor,
+											u8* 					Path,
+											const u8*				Name,
+											u64*					pBacklogPkt,
+											u64*					pLostPkt
+){
+	int fd = 0;	
+
+	fFMADRingHeader_t* RING = FMADPacket_OpenRxMap(&fd, Path);
+	if (RING == NULL) return -1;
+
+	bool IsPrev = true;
+
+	fFMADRingCursor_t* C = &RING->Cursor[0];
+	if ((Name != NULL) && (Name[0] != 0))
+	{
+		C = FMADPacket_CursorClaim(RING, Name, &IsPrev);
+		if (C == NULL)
+		{
+			munmap(RING, FMADPacket_MapSize(RING));
+			close(fd);
+			return -1;
+		}
+	}
+	else
+	{
+		FMADPacket_CursorExpire(RING);
+		if (C->Flag & FMADRING_CURSOR_FLAG_ACTIVE)
+		{
+			fprintf(stderr, "RING[%-50s] WARNING default reader already attached pid %i, use a named reader\n", Path, C->PID);
+		}
+	}
+
+	s64 BacklogPkt	= 0;
+	u64 LostPkt		= 0;
+	if (IsPrev)
+	{
+		BacklogPkt = FMADPacket_CursorResume(RING, C, &LostPkt);
+	}
+	else
+	{
+		FMADPacket_CursorStart(RING, C);
+	}
+
+	fprintf(stderr, "RING[%-50s] reader %li [%s] resumed Get:%llx Put:%llx backlog %lli pkts lost %lli pkts (total %lli pkts %lli bytes)\n", 
+				Path, C - RING->Cursor, C->Name, C->Get, RING->Put, BacklogPkt, LostPkt, C->LostPkt, C->LostByte);
+
+	// update files
+	if (pfd) 			pfd[0] 			= fd;
+	if (pRing) 			pRing[0] 		= RING;
+	if (pCursor)		pCursor[0]		= C;
+	if (pBacklogPkt)	pBacklogPkt[0]	= BacklogPkt;
+	if (pLostPkt)		pLostPkt[0]		= LostPkt;
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// wait for packets to be available on the rx side 
+// returns number of packets between Get and a single snapshot of Put, 0 if nothing available
+// for a packed ring its the number of bytes between GetPos and PutPos
+static inline s64 FMADPacket_RecvWaitCursor(	fFMADRingHeader_t* 	RING, 
+												fFMADRingCursor_t*	C,
+												bool 				IsWait
+											)
 {
-	fFMADRingPacket_t* Pkt = NULL;
+	bool IsPacked	= (RING->Version == FMADRING_VERSION2);
+	bool IsCache	= FMADPacket_IsCache(RING);
+
+	s64 Avail	= 0;
+	u64 TS0		= 0;
 	u32 Backoff = 0;
 	do 
 	{
-		if (RING->Put != RING->Get)
+		// the producers cache line is only read once the cached Put has been consumed
+		if (IsPacked)
 		{
-			if (RING->Put < RING->Get) break;
+			Avail = C->PutPosCache - C->GetPos;
+			if ((Avail > 0) && IsCache) break;
 
-			Pkt = &RING->Packet[ RING->Get & RING->Mask ]; 
-			break;
+			C->PutPosCache = RING->PutPos;
+			Avail = C->PutPosCache - C->GetPos;
+			if (Avail > 0) break;
 		}
+		else
+		{
+			s64 Put = C->PutCache;
+			s64 Get = C->Get;
+			if ((Put <= Get) || !IsCache)
+			{
+				// single read of the producers cache line
+				Put = RING->Put;
+				C->PutCache = Put;
+			}
+			if (Put != Get)
+			{
+				if (Put < Get) break;
+
+				// producer without flow control may have lapped it
+				int Lap = FMADPacket_IsOverwrite(RING) ? FMADPacket_RecvOverrun(RING, C) : 0;
+				if (Lap > 0)
+				{
+					Put = C->PutCache;
+					Get = C->Get;
+				}
+
+				// nothing intact to read yet, wait like an empty ring
+				if (Lap >= 0)
+				{
+					Avail = Put - Get;
+					break;
+				}
+			}
+		}
+		Avail = 0;
+
+		// blocking wait on an empty ring
+		if (IsWait && (TS0 == 0)) TS0 = rdtsc();
 
 		ndelay(100);
 		Backoff++;
@@ -477,40 +2652,500 @@ static inline int FMADPacket_RecvV1a(	fFMADRingHeader_t* RING,
 		if (Backoff > 100)
 		{
 			Backoff = 0;
-			usleep(0);
+			FMADPacket_RecvIdle(RING, C, FMADRING_FUTEX_TIMEOUT);
 		}
 
 	} while (IsWait);
 
-	if (!Pkt)
+	if (TS0 != 0) FMADPacket_StatRecvStall(RING, TS0);
+
+	return Avail;
+}
+
+//---------------------------------------------------------------------------------------------
+// zero copy receive. returns a pointer to the packet in the ring slot without copying it
+// the slot is owned by the caller until FMADPacket_RecvReleaseCursor is called, the producer
+// can not re-use it until then. Get is only published on release
+//
+// returns LengthCapture of the packet, 0 if no packet is available and -1 on EOF
+static inline int FMADPacket_RecvPeekCursor(	fFMADRingHeader_t* 			RING, 
+												fFMADRingCursor_t*			C,
+												bool 						IsWait,
+												const fFMADRingPacket_t** 	pPkt
+											) 
+{
+	if (FMADPacket_RecvWaitCursor(RING, C, IsWait) == 0)
 	{
-		//ndelay(100);
 		return 0;
 	}
 
-	// data stream finished
+	fFMADRingPacket_t* Pkt = NULL;
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		fFMADRingRecord_t* Rec = FMADPacket_PackedRecord(RING, C->GetPos);
+
+		// wrap padding holds no packet, release it straight away
+		if (Rec->Flag & FMADRING_RECORD_FLAG_WRAP)
+		{
+			C->GetPos 	+= Rec->Size;
+			Rec			= FMADPacket_PackedRecord(RING, C->GetPos);
+		}
+		Pkt = FMADPacket_PackedPacket(Rec);
+	}
+	else
+	{
+		Pkt = &RING->Packet[ C->Get & RING->Mask ]; 
+	}
+
+	// data stream finished. slot is not consumed so every read returns EOF
 	if (Pkt->Flag & FMADRING_FLAG_EOF)
 	{
 		return -1;
 	}
 
-	// make copy of relevant data
-	if (pTS) 			pTS[0] 				= Pkt->TS;
-	if (pLengthWire) 	pLengthWire[0] 		= Pkt->LengthWire;
-	if (pLengthCapture) pLengthCapture[0] 	= Pkt->LengthCapture;
-	if (pPort)			pPort[0]			= Pkt->Port;
-	if (pFlag)			pFlag[0]			= Pkt->Flag;
-	if (pStorageID)		pStorageID[0]		= Pkt->StorageID;
-	if (Payload)		memcpy(Payload, Pkt->Payload, Pkt->LengthCapture);
+	if (pPkt) pPkt[0] = Pkt;
+
+	return Pkt->LengthCapture;
+}
+
+//---------------------------------------------------------------------------------------------
+// release a packet returned by FMADPacket_RecvPeekCursor back to the producer. a producer 
+// without flow control can lap the reader while it holds the slot, the stamp is checked again
+// seqlock style. returns false if the slot was re-written, the packet is counted as lost and 
+// anything read from it may be torn. readers copy the packet out before releasing it and
+// only hand the copy on when this returns true
+static inline bool FMADPacket_RecvReleaseCursor(	fFMADRingHeader_t* 			RING, 
+													fFMADRingCursor_t*			C,
+													const fFMADRingPacket_t* 	Pkt
+												)
+{
+	// all reads of the slot must complete before the producer can see it free
+	__asm__ volatile("" ::: "memory");
+
+	// the slot may be re-written under it, read the length and stamp once
+	u32 Length = Pkt->LengthCapture;
+	u64 PutTSC = FMADPacket_PacketTSC(RING, Pkt);
+
+	// x86 keeps loads in order, Seq is read after the slot contents
+	bool IsIntact = true;
+	if (FMADPacket_IsOverwrite(RING) && (Pkt->Seq != C->Get + 1))
+	{
+		C->LostPkt		+= 1;
+		C->LostByte		+= Length;
+		IsIntact		= false;
+	}
+
+	// latency once per packet delivered, not per peek
+	if (IsIntact) FMADPacket_StatLatencyTSC(RING, PutTSC);
 
-	//sfence();
+	// packed ring frees the bytes of the record
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		C->GetPos 	+= FMADPacket_PackedRecordOf(Pkt)->Size;
+	}
 
 	// next
-	RING->Get 		+= 1;
-	RING->GetByte 	+= Pkt->LengthCapture;
-	RING->GetPktTS	= Pkt->TS; 
+	C->Get 		+= 1;
+	C->GetByte 	+= Length;
+	C->GetPktTS	= Pkt->TS; 
 
-	return Pkt->LengthCapture;
+	FMADPacket_GetNotify(RING);
+
+	return IsIntact;
+}
+
+//---------------------------------------------------------------------------------------------
+// batched zero copy receive. fills Batch with up to PktMax packets from a single snapshot 
+// of Put. slots are owned by the caller until FMADPacket_RecvBatchReleaseCursor is called
+// which publishes Get/GetByte/GetPktTS once for the whole batch
+//
+// an EOF marker ends the batch, it is returned as -1 on the next call once the 
+// packets before it have been released
+//
+// returns number of packets in the batch, 0 if no packet is available and -1 on EOF
+static inline int FMADPacket_RecvBatchCursor(	fFMADRingHeader_t* 	RING, 
+												fFMADRingCursor_t*	C,
+												bool 				IsWait,
+												fFMADRingBatch_t*	Batch,
+												u32					PktMax
+											)
+{
+	Batch->PktCnt		= 0;
+	Batch->Byte			= 0;
+	Batch->LastTS		= 0;
+	Batch->RecordByte	= 0;
+	Batch->CheckCnt		= 0;
+
+	s64 Avail = FMADPacket_RecvWaitCursor(RING, C, IsWait);
+	if (Avail == 0) return 0;
+
+	if (PktMax > FMADRING_BATCH_MAX) PktMax = FMADRING_BATCH_MAX;
+
+	// packed ring walk the records up to the PutPos snapshot
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		s64 Pos = C->GetPos;
+		s64 End = Pos + Avail;
+		while ((Pos < End) && (Batch->PktCnt < PktMax))
+		{
+			fFMADRingRecord_t* Rec = FMADPacket_PackedRecord(RING, Pos);
+			if (Rec->Flag & FMADRING_RECORD_FLAG_WRAP)
+			{
+				Pos += Rec->Size;
+				continue;
+			}
+
+			fFMADRingPacket_t* Pkt = FMADPacket_PackedPacket(Rec);
+
+			// data stream finished
+			if (Pkt->Flag & FMADRING_FLAG_EOF)
+			{
+				if (Batch->PktCnt == 0) return -1;
+				break;
+			}
+
+			Batch->Length[Batch->PktCnt] = Pkt->LengthCapture;
+			Batch->Pkt[Batch->PktCnt++] = Pkt;
+			Batch->Byte		+= Pkt->LengthCapture;
+			Batch->LastTS	= Pkt->TS;
+
+			Pos += Rec->Size;
+		}
+		Batch->RecordByte = Pos - C->GetPos;
+
+		FMADPacket_StatLatency(RING, Batch->Pkt, Batch->PktCnt);
+
+		return Batch->PktCnt;
+	}
+
+	if (Avail > PktMax) Avail = PktMax;
+
+	bool IsOverwrite = FMADPacket_IsOverwrite(RING);
+
+	s64 Get = C->Get;
+	for (int i=0; i < Avail; i++)
+	{
+		fFMADRingPacket_t* Pkt = &RING->Packet[ (Get + i) & RING->Mask ]; 
+
+		// producer is overwriting the rest, picked up by the next call
+		if (IsOverwrite && (Pkt->Seq != Get + i + 1)) break;
+
+		// data stream finished
+		if (Pkt->Flag & FMADRING_FLAG_EOF)
+		{
+			if (i == 0) return -1;
+			break;
+		}
+
+		Batch->Pkt[i]	= Pkt;
+		Batch->Length[i]= Pkt->LengthCapture;
+		Batch->Byte		+= Batch->Length[i];
+		Batch->LastTS	= Pkt->TS;
+		Batch->PktCnt++;
+	}
+
+	FMADPacket_StatLatency(RING, Batch->Pkt, Batch->PktCnt);
+
+	return Batch->PktCnt;
+}
+
+//---------------------------------------------------------------------------------------------
+// a zero copy reader of a ring without flow control can be lapped while it holds the slots.
+// once packet Index of the batch is copied out the slot stamp is checked again, seqlock style,
+// before the copy is handed on. returns false if the producer has started re-writing the slot,
+// the copy may be torn and the packet is counted as lost. packets are checked in order, the 
+// ones after the last checked are checked on release
+static inline bool FMADPacket_RecvBatchCheck(	fFMADRingHeader_t* 	RING, 
+												fFMADRingCursor_t*	C,
+												fFMADRingBatch_t*	Batch,
+												u32					Index
+											)
+{
+	if (!FMADPacket_IsOverwrite(RING)) return true;
+
+	// x86 keeps loads in order, Seq is read after the copy
+	__asm__ volatile("" ::: "memory");
+
+	Batch->CheckCnt = Index + 1;
+
+	const fFMADRingPacket_t* Pkt = Batch->Pkt[Index];
+	if (Pkt->Seq == C->Get + Index + 1) return true;
+
+	C->LostPkt		+= 1;
+	C->LostByte		+= Batch->Length[Index];
+
+	return false;
+}
+
+//---------------------------------------------------------------------------------------------
+// release all packets returned by FMADPacket_RecvBatch back to the producer. packets not yet
+// checked with FMADPacket_RecvBatchCheck are checked here, returns the number that were 
+// re-written by a producer without flow control and counted as lost
+static inline u32 FMADPacket_RecvBatchReleaseCursor(	fFMADRingHeader_t* 	RING, 
+														fFMADRingCursor_t*	C,
+														fFMADRingBatch_t*	Batch
+													)
+{
+	if (Batch->PktCnt == 0) return 0;
+
+	// all reads of the slots must complete before the producer can see them free
+	__asm__ volatile("" ::: "memory");
+
+	u32 LostCnt = 0;
+	if (FMADPacket_IsOverwrite(RING))
+	{
+		for (u32 i=Batch->CheckCnt; i < Batch->PktCnt; i++)
+		{
+			if (!FMADPacket_RecvBatchCheck(RING, C, Batch, i)) LostCnt++;
+		}
+	}
+
+	// packed ring frees the bytes of the records
+	if (RING->Version == FMADRING_VERSION2)
+	{
+		C->GetPos 	+= Batch->RecordByte;
+	}
+
+	// single publish for the batch
+	C->Get 		+= Batch->PktCnt;
+	C->GetByte 	+= Batch->Byte;
+	C->GetPktTS	= Batch->LastTS; 
+
+	FMADPacket_GetNotify(RING);
+
+	Batch->PktCnt	= 0;
+
+	return LostCnt;
+}
+
+//---------------------------------------------------------------------------------------------
+// work-sharing group receive. claims up to PktMax packets for this worker, the slots are
+// owned by the worker until FMADPacket_RecvGroupRelease. the EOF marker is never claimed, 
+// every worker sees it
+//
+// returns number of packets in the batch, 0 if no packet is available and -1 on EOF
+static inline int FMADPacket_RecvGroupBatch(	fFMADRingHeader_t* 	RING, 
+												fFMADRingCursor_t*	C,
+												bool 				IsWait,
+												fFMADRingBatch_t*	Batch,
+												u32					PktMax
+											)
+{
+	Batch->PktCnt		= 0;
+	Batch->Byte			= 0;
+	Batch->LastTS		= 0;
+	Batch->RecordByte	= 0;
+	Batch->CheckCnt		= 0;
+
+	if (PktMax > FMADRING_BATCH_MAX) PktMax = FMADRING_BATCH_MAX;
+
+	u64 TS0		= 0;
+	u32 Backoff = 0;
+	while (true)
+	{
+		s64 Claim = C->Claim;
+		s64 Avail = RING->Put - Claim;
+		if (Avail > 0)
+		{
+			if (Avail > PktMax) Avail = PktMax;
+
+			// stop in front of the EOF marker
+			u32 Cnt = 0;
+			for (; Cnt < Avail; Cnt++)
+			{
+				if (RING->Packet[ (Claim + Cnt) & RING->Mask ].Flag & FMADRING_FLAG_EOF) break;
+			}
+			if (Cnt == 0) return -1;
+
+			// another worker got there first
+			if (!__sync_bool_compare_and_swap(&C->Claim, Claim, Claim + Cnt)) continue;
+
+			Batch->Claim = Claim;
+			for (int i=0; i < Cnt; i++)
+			{
+				fFMADRingPacket_t* Pkt = &RING->Packet[ (Claim + i) & RING->Mask ]; 
+
+				Batch->Pkt[i]	= Pkt;
+				Batch->Length[i]= Pkt->LengthCapture;
+				Batch->Byte		+= Pkt->LengthCapture;
+				Batch->LastTS	= Pkt->TS;
+			}
+			Batch->PktCnt = Cnt;
+
+			if (TS0 != 0) FMADPacket_StatRecvStall(RING, TS0);
+			FMADPacket_StatLatency(RING, Batch->Pkt, Batch->PktCnt);
+
+			return Cnt;
+		}
+
+		if (!IsWait) return 0;
+
+		// blocking wait on an empty ring
+		if (TS0 == 0) TS0 = rdtsc();
+
+		ndelay(100);
+		Backoff++;
+
+		// yeild the thread after a trying hard for a bit 
+		if (Backoff > 100)
+		{
+			Backoff = 0;
+			FMADPacket_RecvIdle(RING, C, FMADRING_FUTEX_TIMEOUT);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------
+// complete a work-sharing batch. waits for the batches claimed before it to complete so Get
+// only ever moves over slots every worker is finished with
+//
+// returns 0 once released. -1 if the earlier claims made no progress for TimeoutNS, a member
+// died or stalled holding them. the batch is kept, the caller can retry or detach from the group
+static inline int FMADPacket_RecvGroupRelease(	fFMADRingHeader_t* 	RING, 
+												fFMADRingCursor_t*	C,
+												fFMADRingBatch_t*	Batch,
+												u64					TimeoutNS
+											)
+{
+	if (Batch->PktCnt == 0) return 0;
+
+	// all reads of the slots must complete before the producer can see them free
+	__asm__ volatile("" ::: "memory");
+
+	s64 Get		= C->Get;
+	u64 TS0		= rdtsc();
+	u32 Backoff = 0;
+	while (Get != Batch->Claim)
+	{
+		// any earlier batch completing restarts the timeout
+		s64 GetNow = C->Get;
+		if (GetNow != Get)
+		{
+			Get = GetNow;
+			TS0	= rdtsc();
+			continue;
+		}
+		if (tsc2ns(rdtsc() - TS0) > TimeoutNS)
+		{
+			fprintf(stderr, "RING[%-50s] ERROR group [%s] claim %llx stalled %.3f sec waiting on Get:%llx\n", RING->Path, C->Name, Batch->Claim, TimeoutNS / 1e9, Get);
+			return -1;
+		}
+
+		__asm__ volatile("pause");
+
+		// earlier worker descheduled
+		if (++Backoff > 1000)
+		{
+			Backoff = 0;
+			usleep(0);
+		}
+	}
+
+	// Get is published last, the next worker only updates the totals after it sees it
+	C->GetByte 		+= Batch->Byte;
+	C->GetPktTS		= Batch->LastTS; 
+	C->Get 			= Batch->Claim + Batch->PktCnt;
+
+	FMADPacket_GetNotify(RING);
+
+	Batch->PktCnt	= 0;
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// default reader 
+static inline s64 FMADPacket_RecvWait(	fFMADRingHeader_t* 	RING, 
+										bool 				IsWait
+									)
+{
+	return FMADPacket_RecvWaitCursor(RING, &RING->Cursor[0], IsWait);
+}
+static inline int FMADPacket_RecvPeekV1(	fFMADRingHeader_t* 			RING, 
+											bool 						IsWait,
+											const fFMADRingPacket_t** 	pPkt
+										) 
+{
+	return FMADPacket_RecvPeekCursor(RING, &RING->Cursor[0], IsWait, pPkt);
+}
+static inline bool FMADPacket_RecvReleaseV1(	fFMADRingHeader_t* 			RING, 
+												const fFMADRingPacket_t* 	Pkt
+											)
+{
+	return FMADPacket_RecvReleaseCursor(RING, &RING->Cursor[0], Pkt);
+}
+static inline int FMADPacket_RecvBatch(	fFMADRingHeader_t* 	RING, 
+										bool 				IsWait,
+										fFMADRingBatch_t*	Batch,
+										u32					PktMax
+									)
+{
+	return FMADPacket_RecvBatchCursor(RING, &RING->Cursor[0], IsWait, Batch, PktMax);
+}
+static inline u32 FMADPacket_RecvBatchRelease(	fFMADRingHeader_t* 	RING, 
+												fFMADRingBatch_t*	Batch
+											)
+{
+	return FMADPacket_RecvBatchReleaseCursor(RING, &RING->Cursor[0], Batch);
+}
+
+//---------------------------------------------------------------------------------------------
+// get a packet non-zero copy way but simple interface. pMeta gets the producers parsed 
+// headers, Flag is 0 when the ring does not carry them (FMADRING_FEATURE_META)
+static inline int FMADPacket_RecvV1b(	fFMADRingHeader_t* RING, 
+										bool IsWait,
+										u64*				pTS,	
+										u32*				pLengthWire,	
+										u32*				pLengthCapture,	
+										u32*				pPort,	
+										u32*				pFlag,	
+										u64*				pStorageID,	
+										fFMADRingMeta_t*	pMeta,	
+										void*				Payload	
+										) 
+{
+	const fFMADRingPacket_t* Pkt = NULL;
+
+	while (true)
+	{
+		int ret = FMADPacket_RecvPeekV1(RING, IsWait, &Pkt);
+		if (ret <= 0) return ret;
+
+		// make copy of relevant data
+		if (pTS) 			pTS[0] 				= Pkt->TS;
+		if (pLengthWire) 	pLengthWire[0] 		= Pkt->LengthWire;
+		if (pLengthCapture) pLengthCapture[0] 	= Pkt->LengthCapture;
+		if (pPort)			pPort[0]			= Pkt->Port;
+		if (pFlag)			pFlag[0]			= Pkt->Flag;
+		if (pStorageID)		pStorageID[0]		= Pkt->StorageID;
+		if (Payload)		memcpy(Payload, Pkt->Payload, Pkt->LengthCapture);
+		if (pMeta)
+		{
+			fFMADRingMeta_t* Meta = FMADPacket_PacketMeta(RING, Pkt);
+			if (Meta)		pMeta[0]			= Meta[0];
+			else			memset(pMeta, 0, sizeof(fFMADRingMeta_t));
+		}
+
+		// producer without flow control overwrote it during the copy, the next peek skips ahead
+		if (!FMADPacket_RecvReleaseV1(RING, Pkt)) continue;
+
+		return ret;
+	}
+}
+
+// backwards compat
+static inline int FMADPacket_RecvV1a(	fFMADRingHeader_t* RING, 
+										bool IsWait,
+										u64*		pTS,	
+										u32*		pLengthWire,	
+										u32*		pLengthCapture,	
+										u32*		pPort,	
+										u32*		pFlag,	
+										u64*		pStorageID,	
+										void*		Payload	
+										) 
+{
+	return FMADPacket_RecvV1b(RING, IsWait, pTS, pLengthWire, pLengthCapture, pPort, pFlag, pStorageID, NULL, Payload);
 }
 
 // backwards compat
@@ -562,6 +3197,148 @@ static inline u64 FMADPacket_PktTSGet( fFMADRingHeader_t* RING)
 	return RING->GetPktTS;
 }
 
+//---------------------------------------------------------------------------------------------
+// ring set, software RSS. Count rings under one base path, <base>.0 .. <base>.N-1, the producer
+// picks the ring with a symmetric 5-tuple hash so both directions of a flow land on the same
+// ring and each reader sees complete flows. readers attach to a single shard by its path.
+// a set of 1 is the base path ring itself
+
+typedef struct fFMADRingSet_t
+{
+	u32					Count;						// number of rings in the set
+	int					fd[FMADRING_SET_MAX];		// ring file handles
+	fFMADRingHeader_t*	Ring[FMADRING_SET_MAX];		// mapped rings
+
+} fFMADRingSet_t;
+
+// path of a shard, what a reader attaches to
+static inline void FMADPacket_RingShardPath(u8* Path, u32 PathMax, const u8* Base, u32 Index)
+{
+	snprintf((char*)Path, PathMax, "%s.%i", Base, Index);
+}
+
+// path of a ring in a set of Count
+static inline void FMADPacket_RingSetPath(u8* Path, u32 PathMax, const u8* Base, u32 Count, u32 Index)
+{
+	if (Count <= 1)	snprintf((char*)Path, PathMax, "%s", Base);
+	else			FMADPacket_RingShardPath(Path, PathMax, Base, Index);
+}
+
+// shard for a packet
+static inline u32 FMADPacket_RingSetIndex(fFMADRingSet_t* Set, const void* Payload, u32 Length)
+{
+	if (Set->Count <= 1) return 0;
+
+	u32 Hash = (u32)FMADPacket_FlowHash(Payload, Length);
+	return ((u64)Hash * Set->Count) >> 32;
+}
+
+//---------------------------------------------------------------------------------------------
+// open every ring in the set for tx with the same config
+static inline int FMADPacket_OpenTxSet(	fFMADRingSet_t*				Set,
+										const u8* 					Base,
+										u32							Count,
+										const fFMADRingConfig_t*	Config
+									)
+{
+	if ((Count < 1) || (Count > FMADRING_SET_MAX))
+	{
+		fprintf(stderr, "RING[%-50s] ERROR ring set count %i must be 1 - %i\n", Base, Count, FMADRING_SET_MAX);
+		return -1;
+	}
+
+	memset(Set, 0, sizeof(fFMADRingSet_t));
+	for (int i=0; i < Count; i++)
+	{
+		u8 Path[256];
+		FMADPacket_RingSetPath(Path, sizeof(Path), Base, Count, i);
+
+		if (FMADPacket_OpenTxConfig(&Set->fd[i], &Set->Ring[i], false, Path, Config) < 0) return -1;
+
+		Set->Count = i + 1;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+// write packet to its flows ring 
+static inline int FMADPacket_SendSetV1(	fFMADRingSet_t*		Set,
+										u64 				TS, 
+										u32 				LengthWire,
+										u32 				LengthCapture,
+										u32 				Port,
+										u32					Flag,
+										u64					StorageID,
+										void*	 			Payload
+									)
+{
+	u32 Index = FMADPacket_RingSetIndex(Set, Payload, LengthCapture);
+	return FMADPacket_SendV1(Set->Ring[Index], TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload);
+}
+
+//---------------------------------------------------------------------------------------------
+// write a burst of packets, split by flow and sent to each ring as one batch. packet order
+// within a flow is kept. returns number of packets written over all shards, less than DescCnt 
+// if some were dropped or a shard timed out, the rest of the burst is then not sent. -1 if it 
+// timed out before any were written
+static inline int FMADPacket_SendSetBatch(	fFMADRingSet_t*				Set,
+											const fFMADRingSendDesc_t*	Desc,
+											u32							DescCnt
+										)
+{
+	if (Set->Count <= 1) return FMADPacket_SendBatch(Set->Ring[0], Desc, DescCnt);
+
+	int Total = 0;
+	while (DescCnt > 0)
+	{
+		u32 Cnt = (DescCnt < FMADRING_BATCH_MAX) ? DescCnt : FMADRING_BATCH_MAX;
+
+		// shard of each packet
+		u8 Index[FMADRING_BATCH_MAX];
+		u64 Mask = 0;
+		for (int i=0; i < Cnt; i++)
+		{
+			Index[i] = FMADPacket_RingSetIndex(Set, Desc[i].Payload, Desc[i].LengthCapture);
+			Mask |= 1ULL << Index[i];
+		}
+
+		// one batch per shard present in the burst
+		while (Mask != 0)
+		{
+			u32 Shard = __builtin_ctzll(Mask);
+			Mask &= Mask - 1;
+
+			fFMADRingSendDesc_t ShardDesc[FMADRING_BATCH_MAX];
+			u32 ShardCnt = 0;
+			for (int i=0; i < Cnt; i++)
+			{
+				if (Index[i] == Shard) ShardDesc[ShardCnt++] = Desc[i];
+			}
+
+			int ret = FMADPacket_SendBatch(Set->Ring[Shard], ShardDesc, ShardCnt);
+			if (ret < 0) return (Total > 0) ? Total : -1;
+
+			Total += ret;
+		}
+
+		Desc	+= Cnt;
+		DescCnt	-= Cnt;
+	}
+	return Total;
+}
+
+//---------------------------------------------------------------------------------------------
+// EOF down every ring in the set
+static inline int FMADPacket_SendSetEOF(fFMADRingSet_t* Set, u64 TS)
+{
+	int Result = 0;
+	for (int i=0; i < Set->Count; i++)
+	{
+		if (FMADPacket_SendEOFV1(Set->Ring[i], TS) < 0) Result = -1;
+	}
+	return Result;
+}
+
 //---------------------------------------------------------------------------------------------
 // common pcap fields 
 
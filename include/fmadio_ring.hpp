@@ -0,0 +1,695 @@
+//-------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// C++17 header only layer over the FMADIO ring in fmadio_packet.h, same shared memory format.
+// the slot size, depth, backoff and flow control are template parameters so the slot offset
+// math folds to constants and the hot path has no runtime checks on the wait mode, output
+// pointers, ring version or flow control. fixed slot rings (FMADRING_VERSION) only, without
+// FMADRING_FEATURE_MPSC. anything the template does not cover is on the C API, Header() and
+// Cursor() are the C handles
+//
+//	fmad::Ring<sizeof(fFMADRingPacket_t), 1024> RING;
+//	if (RING.OpenRx("/opt/fmadio/queue/lxc_ring0") < 0) ...
+//
+//	fmad::Batch Batch;
+//	while (RING.Recv(Batch) >= 0)
+//	{
+//		for (fmad::Packet Pkt : Batch) Process(Pkt.TS(), Pkt.Payload());
+//		RING.Release(Batch);
+//	}
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#ifndef  __FMADIO_RING_HPP__
+#define  __FMADIO_RING_HPP__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+
+#include <cstddef>
+#include <utility>
+
+#include "fmadio_packet.h"
+
+namespace fmad
+{
+
+//---------------------------------------------------------------------------------------------
+// backoff policies, what a reader does on an empty ring. Loop is the callers idle count
+
+// never waits, Peek/Recv return 0 on an empty ring
+struct BackoffSpin
+{
+	static constexpr bool	IsWait		= false;
+	static constexpr u32	Feature		= 0;
+
+	static inline void Idle(fFMADRingHeader_t* RING, fFMADRingCursor_t* C, u32& Loop) {}
+};
+
+// busy poll then yield the thread, the C blocking receive on a ring without futex
+struct BackoffPoll
+{
+	static constexpr bool	IsWait		= true;
+	static constexpr u32	Feature		= 0;
+
+	static inline void Idle(fFMADRingHeader_t* RING, fFMADRingCursor_t* C, u32& Loop)
+	{
+		ndelay(100);
+		if (++Loop > 100)
+		{
+			Loop = 0;
+			usleep(0);
+		}
+	}
+};
+
+// busy poll then sleep until the producer publishes. needs FMADRING_FEATURE_FUTEX
+struct BackoffFutex
+{
+	static constexpr bool	IsWait		= true;
+	static constexpr u32	Feature		= FMADRING_FEATURE_FUTEX;
+
+	static inline void Idle(fFMADRingHeader_t* RING, fFMADRingCursor_t* C, u32& Loop)
+	{
+		ndelay(100);
+		if (++Loop > 100)
+		{
+			Loop = 0;
+			FMADPacket_RecvIdle(RING, C, FMADRING_FUTEX_TIMEOUT);
+		}
+	}
+};
+
+//---------------------------------------------------------------------------------------------
+// flow control policies. must match how the ring was created
+
+// producer waits for the slowest reader, nothing is lost
+struct FlowControl
+{
+	static constexpr bool	IsFlowControl	= true;
+	static constexpr bool	IsOverwrite		= false;
+};
+
+// producer never waits and overwrites slots a reader has not got to. readers check the
+// slot stamps and count what they lost, the ring must have FMADRING_FEATURE_SEQ
+struct FlowOverwrite
+{
+	static constexpr bool	IsFlowControl	= false;
+	static constexpr bool	IsOverwrite		= true;
+};
+
+template <typename BackoffT = BackoffPoll, typename FlowT = FlowControl>
+struct Policy
+{
+	using Backoff	= BackoffT;
+	using Flow		= FlowT;
+};
+
+//---------------------------------------------------------------------------------------------
+// contiguous read only bytes, std::span is C++20
+
+template <typename T>
+class Span
+{
+public:
+	constexpr Span() : m_Data(nullptr), m_Size(0) {}
+	constexpr Span(T* Data, size_t Size) : m_Data(Data), m_Size(Size) {}
+
+	constexpr T*		data() const					{ return m_Data; }
+	constexpr size_t	size() const					{ return m_Size; }
+	constexpr bool		empty() const					{ return m_Size == 0; }
+	constexpr T*		begin() const					{ return m_Data; }
+	constexpr T*		end() const						{ return m_Data + m_Size; }
+	constexpr T&		operator[](size_t Index) const	{ return m_Data[Index]; }
+
+private:
+	T*					m_Data;
+	size_t				m_Size;
+};
+
+//---------------------------------------------------------------------------------------------
+// zero copy view of a received packet in its ring slot, valid until released
+
+class Packet
+{
+public:
+	Packet() : m_Pkt(nullptr), m_IsMeta(false) {}
+	explicit Packet(const fFMADRingPacket_t* Pkt, bool IsMeta = false) : m_Pkt(Pkt), m_IsMeta(IsMeta) {}
+
+	u64					TS() const				{ return m_Pkt->TS; }
+	u32					LengthWire() const		{ return m_Pkt->LengthWire; }
+	u32					LengthCapture() const	{ return m_Pkt->LengthCapture; }
+	u32					Port() const			{ return m_Pkt->Port; }
+	u32					Flag() const			{ return m_Pkt->Flag; }
+	u64					StorageID() const		{ return m_Pkt->StorageID; }
+
+	Span<const u8>		Payload() const			{ return Span<const u8>(m_Pkt->Payload, m_Pkt->LengthCapture); }
+
+	// metadata, nullptr when the ring is not FMADRING_FEATURE_META
+	const fFMADRingMeta_t* Meta() const			{ return m_IsMeta ? (const fFMADRingMeta_t*)&m_Pkt->Meta : nullptr; }
+
+	const fFMADRingPacket_t* Slot() const		{ return m_Pkt; }
+
+private:
+	const fFMADRingPacket_t* m_Pkt;
+	bool					m_IsMeta;			// slot carries the producers parsed headers
+};
+
+//---------------------------------------------------------------------------------------------
+// packets of a batched receive, owned by the caller until released
+
+class Batch
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator(const fFMADRingPacket_t* const* Pkt, bool IsMeta) : m_Pkt(Pkt), m_IsMeta(IsMeta) {}
+
+		Packet		operator*() const						{ return Packet(*m_Pkt, m_IsMeta); }
+		Iterator&	operator++()							{ m_Pkt++; return *this; }
+		bool		operator!=(const Iterator& Other) const	{ return m_Pkt != Other.m_Pkt; }
+		bool		operator==(const Iterator& Other) const	{ return m_Pkt == Other.m_Pkt; }
+
+	private:
+		const fFMADRingPacket_t* const* m_Pkt;
+		bool						m_IsMeta;
+	};
+
+	u32				size() const					{ return m_PktCnt; }
+	bool			empty() const					{ return m_PktCnt == 0; }
+	Iterator		begin() const					{ return Iterator(m_Pkt, m_IsMeta); }
+	Iterator		end() const						{ return Iterator(m_Pkt + m_PktCnt, m_IsMeta); }
+	Packet			operator[](u32 Index) const		{ return Packet(m_Pkt[Index], m_IsMeta); }
+
+	u64				Byte() const					{ return m_Byte; }
+	u64				LastTS() const					{ return m_LastTS; }
+
+private:
+	template <u64, u64, typename> friend class Ring;
+
+	u32						m_PktCnt	= 0;
+	u32						m_CheckCnt	= 0;		// packets checked intact so far (FlowOverwrite)
+	u64						m_Byte		= 0;
+	u64						m_LastTS	= 0;
+	bool					m_IsMeta	= false;	// FMADRING_FEATURE_META ring
+	const fFMADRingPacket_t* m_Pkt[FMADRING_BATCH_MAX];
+	u16						m_Length[FMADRING_BATCH_MAX];	// capture length when received (FlowOverwrite)
+};
+
+//---------------------------------------------------------------------------------------------
+// a mapped ring, as the producer (OpenTx) or one reader (OpenRx). unmapped on destruction,
+// a reader is detached first. errors are reported like the C API, -1 and a RING[] line
+
+template <u64 SlotSize, u64 Depth, typename PolicyT = Policy<>>
+class Ring
+{
+public:
+	using Backoff	= typename PolicyT::Backoff;
+	using Flow		= typename PolicyT::Flow;
+
+	static_assert(SlotSize == sizeof(fFMADRingPacket_t), "the shared memory format has a single slot layout");
+	static_assert((Depth >= 2) && ((Depth & (Depth - 1)) == 0), "Depth must be a power of 2");
+
+	static constexpr u64 Mask		= Depth - 1;
+	static constexpr u64 SlotBase	= offsetof(fFMADRingHeader_t, Packet);
+
+	// byte offset of a slot from the start of the mapping
+	static constexpr u64 SlotOffset(s64 Index) { return SlotBase + ((u64)Index & Mask) * SlotSize; }
+
+	Ring() = default;
+	~Ring() { Close(); }
+
+	Ring(const Ring&) = delete;
+	Ring& operator=(const Ring&) = delete;
+
+	Ring(Ring&& Other) noexcept { Move(Other); }
+	Ring& operator=(Ring&& Other) noexcept
+	{
+		if (this != &Other)
+		{
+			Close();
+			Move(Other);
+		}
+		return *this;
+	}
+
+	bool				IsOpen() const		{ return m_RING != nullptr; }
+	fFMADRingHeader_t*	Header() const		{ return m_RING; }
+	fFMADRingCursor_t*	Cursor() const		{ return m_C; }
+
+	//-----------------------------------------------------------------------------------------
+	// open as the producer, creating the ring if it does not exist or IsReset. an existing
+	// ring and its attached readers are kept unless IsReset. Feature is FMADRING_FEATURE_* 
+	// on top of what the backoff policy needs
+	int OpenTx(const char* Path, bool IsReset = false, u32 Feature = 0, u64 TimeoutNS = 60e9)
+	{
+		Close();
+
+		fFMADRingConfig_t Config;
+		FMADPacket_ConfigDefault(&Config);
+
+		Config.Version			= FMADRING_VERSION;
+		Config.Depth			= Depth;
+		Config.IsFlowControl	= Flow::IsFlowControl;
+		Config.TimeoutNS		= TimeoutNS;
+		Config.Feature			= Feature | Backoff::Feature;
+
+		if (FMADPacket_OpenTxConfig(&m_fd, &m_RING, IsReset, (u8*)Path, &Config) < 0)
+		{
+			m_RING = nullptr;
+			return -1;
+		}
+		return Check();
+	}
+
+	// attach as a reader. Name empty is the default reader, IsResume continues from where
+	// the reader left off, see FMADPacket_OpenRxResume
+	int OpenRx(const char* Path, const char* Name = "", bool IsResume = false)
+	{
+		Close();
+
+		int ret = 0;
+		if (IsResume)	ret = FMADPacket_OpenRxResume(&m_fd, &m_RING, &m_C, (u8*)Path, (const u8*)Name, &m_BacklogPkt, &m_LostPkt);
+		else			ret = FMADPacket_OpenRxCursor(&m_fd, &m_RING, &m_C, (u8*)Path, (const u8*)Name);
+		if (ret < 0)
+		{
+			m_RING	= nullptr;
+			m_C		= nullptr;
+			return -1;
+		}
+		return Check();
+	}
+
+	// packets backlogged and lost when a reader resumed
+	u64 BacklogPkt() const	{ return m_BacklogPkt; }
+	u64 LostPkt() const		{ return m_LostPkt; }
+
+	void Close()
+	{
+		if (m_RING == nullptr) return;
+
+		if (m_C != nullptr) FMADPacket_CursorDetach(m_RING, m_C);
+
+		munmap(m_RING, FMADPacket_MapSize(m_RING));
+		close(m_fd);
+
+		m_RING	= nullptr;
+		m_C		= nullptr;
+		m_fd	= -1;
+	}
+
+	//-----------------------------------------------------------------------------------------
+	// producer. returns LengthCapture, -1 if the readers did not drain within TxTimeout
+	inline int Send(u64 TS, u32 LengthWire, u32 LengthCapture, u32 Port, u32 Flag, u64 StorageID, const void* Payload)
+	{
+		fFMADRingHeader_t* RING = m_RING;
+
+		s64 Put = RING->Put;
+		if (!Reserve(Put, 1)) return -1;
+
+		u64 PutByte = RING->PutByte;
+		Write(Slot(Put), Put, PutByte, m_IsLatency ? rdtsc() : 0, TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload);
+
+		sfence();
+
+		// publish
+		RING->Put 		= Put + 1;
+		RING->PutByte 	= PutByte + LengthCapture;
+		RING->PutPktTS 	= TS;
+
+		FMADPacket_PutNotify(RING);
+		FMADPacket_StatPublish(RING, Put, Put + 1);
+
+		return LengthCapture;
+	}
+
+	// burst send, published once per chunk of free slots
+	// returns DescCnt, fewer if the readers did not drain within TxTimeout part way through
+	// and -1 if they did not before any were written
+	inline int SendBatch(const fFMADRingSendDesc_t* Desc, u32 DescCnt)
+	{
+		fFMADRingHeader_t* RING = m_RING;
+
+		u32 Pos = 0;
+		while (Pos < DescCnt)
+		{
+			s64 Put		= RING->Put;
+			s64 Free	= DescCnt - Pos;
+			if constexpr (Flow::IsFlowControl)
+			{
+				Free = FMADPacket_SendWait(RING, DescCnt - Pos);
+				if (Free < 0) return (Pos > 0) ? Pos : -1;
+			}
+
+			u64 PutByte	= RING->PutByte;
+			u64 Byte	= 0;
+			u64 PutTSC	= m_IsLatency ? rdtsc() : 0;
+			for (s64 i=0; i < Free; i++)
+			{
+				const fFMADRingSendDesc_t* D = &Desc[Pos + i];
+				Write(Slot(Put + i), Put + i, PutByte + Byte, PutTSC, D->TS, D->LengthWire, D->LengthCapture, D->Port, D->Flag, D->StorageID, D->Payload);
+				Byte += D->LengthCapture;
+			}
+
+			sfence();
+
+			// publish
+			RING->Put 		= Put + Free;
+			RING->PutByte 	= PutByte + Byte;
+			RING->PutPktTS 	= Desc[Pos + Free - 1].TS;
+
+			FMADPacket_PutNotify(RING);
+			FMADPacket_StatPublish(RING, Put, Put + Free);
+
+			Pos += Free;
+		}
+		return DescCnt;
+	}
+
+	// end of stream marker. returns 0, -1 on timeout
+	int SendEOF(u64 TS) { return FMADPacket_SendEOFV1(m_RING, TS); }
+
+	//-----------------------------------------------------------------------------------------
+	// reader. zero copy receive of the next packet, the slot is owned until Release
+	// returns LengthCapture, 0 if no packet is available and -1 on EOF
+	inline int Peek(Packet& Pkt)
+	{
+		if (Wait() == 0) return 0;
+
+		const fFMADRingPacket_t* P = Slot(m_C->Get);
+		if constexpr (Flow::IsOverwrite)
+		{
+			// overwritten since Wait, picked up by the next call
+			if (P->Seq != m_C->Get + 1) return 0;
+		}
+
+		// data stream finished. slot is not consumed so every read returns EOF
+		if (P->Flag & FMADRING_FLAG_EOF) return -1;
+
+		Pkt = Packet(P, m_IsMeta);
+		return P->LengthCapture;
+	}
+
+	// returns false if a producer without flow control re-wrote the slot while it was held, 
+	// the packet is counted as lost and anything read from it may be torn
+	inline bool Release(const Packet& Pkt)
+	{
+		fFMADRingCursor_t* C = m_C;
+
+		// all reads of the slot must complete before the producer can see it free
+		__asm__ volatile("" ::: "memory");
+
+		// the slot may be re-written under it, read the length and stamp once
+		u32 Length = Pkt.LengthCapture();
+		u64 PutTSC = m_IsLatency ? Pkt.Slot()->PutTSC : 0;
+
+		bool IsIntact = true;
+		if constexpr (Flow::IsOverwrite)
+		{
+			if (Pkt.Slot()->Seq != C->Get + 1)
+			{
+				C->LostPkt	+= 1;
+				C->LostByte	+= Length;
+				IsIntact	= false;
+			}
+		}
+
+		// latency once per packet delivered, not per peek
+		if (m_IsLatency && IsIntact) FMADPacket_StatLatencyTSC(m_RING, PutTSC);
+
+		C->Get 		+= 1;
+		C->GetByte 	+= Length;
+		C->GetPktTS	= Pkt.TS();
+
+		FMADPacket_GetNotify(m_RING);
+
+		return IsIntact;
+	}
+
+	// batched zero copy receive of up to PktMax packets. an EOF marker ends the batch and is
+	// returned as -1 once the packets before it have been released
+	// returns number of packets, 0 if none are available and -1 on EOF
+	inline int Recv(Batch& B, u32 PktMax = FMADRING_BATCH_MAX)
+	{
+		B.m_PktCnt	= 0;
+		B.m_CheckCnt= 0;
+		B.m_Byte	= 0;
+		B.m_LastTS	= 0;
+
+		s64 Avail = Wait();
+		if (Avail == 0) return 0;
+
+		if (PktMax > FMADRING_BATCH_MAX) PktMax = FMADRING_BATCH_MAX;
+		if (Avail > PktMax) Avail = PktMax;
+
+		s64 Get = m_C->Get;
+		u64 Byte = 0;
+		u32 Cnt = 0;
+		for (; Cnt < Avail; Cnt++)
+		{
+			const fFMADRingPacket_t* P = Slot(Get + Cnt);
+
+			// producer is overwriting the rest, picked up by the next call
+			if constexpr (Flow::IsOverwrite)
+			{
+				if (P->Seq != Get + Cnt + 1) break;
+			}
+
+			// data stream finished
+			if (P->Flag & FMADRING_FLAG_EOF)
+			{
+				if (Cnt == 0) return -1;
+				break;
+			}
+
+			B.m_Pkt[Cnt]	= P;
+			Byte			+= P->LengthCapture;
+			if constexpr (Flow::IsOverwrite) B.m_Length[Cnt] = P->LengthCapture;
+		}
+		if (Cnt == 0) return 0;
+
+		B.m_PktCnt	= Cnt;
+		B.m_Byte	= Byte;
+		B.m_IsMeta	= m_IsMeta;
+		B.m_LastTS	= B.m_Pkt[Cnt - 1]->TS;
+
+		if (m_IsLatency) FMADPacket_StatLatency(m_RING, B.m_Pkt, Cnt);
+
+		return Cnt;
+	}
+
+	// packet Index of the batch has been copied out, check its slot was not re-written by a 
+	// producer without flow control before handing the copy on. false if it was, the packet is 
+	// counted as lost. see FMADPacket_RecvBatchCheck
+	inline bool IsIntact(Batch& B, u32 Index)
+	{
+		if constexpr (!Flow::IsOverwrite)
+		{
+			return true;
+		}
+		else
+		{
+			__asm__ volatile("" ::: "memory");
+
+			B.m_CheckCnt = Index + 1;
+			if (B.m_Pkt[Index]->Seq == m_C->Get + Index + 1) return true;
+
+			m_C->LostPkt	+= 1;
+			m_C->LostByte	+= B.m_Length[Index];
+			return false;
+		}
+	}
+
+	// packets not checked with IsIntact are checked here
+	// returns the number re-written while held and counted as lost
+	inline u32 Release(Batch& B)
+	{
+		if (B.m_PktCnt == 0) return 0;
+
+		fFMADRingCursor_t* C = m_C;
+
+		// all reads of the slots must complete before the producer can see them free
+		__asm__ volatile("" ::: "memory");
+
+		u32 LostCnt = 0;
+		if constexpr (Flow::IsOverwrite)
+		{
+			for (u32 i=B.m_CheckCnt; i < B.m_PktCnt; i++)
+			{
+				if (!IsIntact(B, i)) LostCnt++;
+			}
+		}
+
+		// single publish for the batch
+		C->Get 		+= B.m_PktCnt;
+		C->GetByte 	+= B.m_Byte;
+		C->GetPktTS	= B.m_LastTS;
+
+		FMADPacket_GetNotify(m_RING);
+
+		B.m_PktCnt = 0;
+
+		return LostCnt;
+	}
+
+private:
+	//-----------------------------------------------------------------------------------------
+
+	inline fFMADRingPacket_t* Slot(s64 Index) const
+	{
+		return (fFMADRingPacket_t*)((u8*)m_RING + SlotOffset(Index));
+	}
+
+	// room for Count packets, only waits once the cached slowest reader says the ring is full
+	inline bool Reserve(s64 Put, u32 Count)
+	{
+		if constexpr (Flow::IsFlowControl)
+		{
+			if (((s64)Mask - (Put - m_RING->GetCache) < (s64)Count) || m_IsNoCache)
+			{
+				if (FMADPacket_SendWait(m_RING, Count) < (s64)Count) return false;
+			}
+		}
+		return true;
+	}
+
+	inline void Write(	fFMADRingPacket_t*	FPkt,
+						s64					Index,
+						u64					Byte,
+						u64					PutTSC,
+						u64					TS,
+						u32					LengthWire,
+						u32					LengthCapture,
+						u32					Port,
+						u32					Flag,
+						u64					StorageID,
+						const void*			Payload)
+	{
+		if constexpr (Flow::IsOverwrite) FMADPacket_SlotSeqClear(FPkt);
+
+		FMADPacket_SlotWrite(FPkt, m_IsMeta ? (fFMADRingMeta_t*)&FPkt->Meta : NULL, TS, LengthWire, LengthCapture, Port, Flag, StorageID, Payload);
+		if (m_IsLatency) FPkt->PutTSC = PutTSC;
+
+		if constexpr (Flow::IsOverwrite) FMADPacket_SlotSeqSet(FPkt, Index, Byte);
+	}
+
+	// packets between Get and a single snapshot of Put, waits per the backoff policy
+	inline s64 Wait()
+	{
+		fFMADRingCursor_t* C = m_C;
+
+		u32 Loop	= 0;
+		u64 TS0		= 0;
+		while (true)
+		{
+			// the producers cache line is only read once the cached Put has been consumed
+			s64 Get = C->Get;
+			s64 Put = C->PutCache;
+			if ((Put <= Get) || m_IsNoCache)
+			{
+				Put = m_RING->Put;
+				C->PutCache = Put;
+			}
+			// producer without flow control may have lapped it. -1 is no intact slot to
+			// read yet, waits like an empty ring
+			int Lap = 0;
+			if constexpr (Flow::IsOverwrite)
+			{
+				if (Put > Get) Lap = FMADPacket_RecvOverrun(m_RING, C);
+				if (Lap > 0)
+				{
+					Put = C->PutCache;
+					Get = C->Get;
+				}
+			}
+			if ((Put > Get) && (Lap >= 0))
+			{
+				if (TS0 != 0) FMADPacket_StatRecvStall(m_RING, TS0);
+				return Put - Get;
+			}
+
+			if constexpr (!Backoff::IsWait)
+			{
+				return 0;
+			}
+			else
+			{
+				if (TS0 == 0) TS0 = rdtsc();
+				Backoff::Idle(m_RING, C, Loop);
+			}
+		}
+	}
+
+	// the mapped ring is the layout and mode the template was built for
+	int Check()
+	{
+		fFMADRingHeader_t* RING = m_RING;
+
+		const char* Error = NULL;
+		if (RING->Version != FMADRING_VERSION)							Error = "not a fixed slot ring";
+		else if (RING->SizePacket != SlotSize)							Error = "slot size missmatch";
+		else if (RING->Depth != Depth)									Error = "depth missmatch";
+		else if (RING->Feature & FMADRING_FEATURE_MPSC)					Error = "multiple producer ring";
+		else if ((bool)RING->IsTxFlowControl != Flow::IsFlowControl)	Error = "flow control missmatch";
+		else if (FMADPacket_IsOverwrite(RING) != Flow::IsOverwrite)		Error = "slot stamp missmatch";
+		else if ((RING->Feature & Backoff::Feature) != Backoff::Feature)	Error = "ring does not have the backoff feature";
+		if (Error != NULL)
+		{
+			fprintf(stderr, "RING[%-50s] ERROR %s, Version:%08x SizePacket:%i Depth:%lli Feature:%08x FlowControl:%i\n",
+						RING->Path, Error, RING->Version, RING->SizePacket, RING->Depth, RING->Feature, RING->IsTxFlowControl);
+			Close();
+			return -1;
+		}
+
+		m_IsLatency	= (RING->Feature & FMADRING_FEATURE_LATENCY) != 0;
+		m_IsMeta	= (RING->Feature & FMADRING_FEATURE_META) != 0;
+		m_IsNoCache	= (RING->Feature & FMADRING_FEATURE_NOCACHE) != 0;
+
+		return 0;
+	}
+
+	void Move(Ring& Other)
+	{
+		m_fd			= Other.m_fd;
+		m_RING			= Other.m_RING;
+		m_C				= Other.m_C;
+		m_IsLatency		= Other.m_IsLatency;
+		m_IsMeta		= Other.m_IsMeta;
+		m_IsNoCache		= Other.m_IsNoCache;
+		m_BacklogPkt	= Other.m_BacklogPkt;
+		m_LostPkt		= Other.m_LostPkt;
+
+		Other.m_fd		= -1;
+		Other.m_RING	= nullptr;
+		Other.m_C		= nullptr;
+	}
+
+	int						m_fd			= -1;			// ring file handle
+	fFMADRingHeader_t*		m_RING			= nullptr;		// mapping
+	fFMADRingCursor_t*		m_C				= nullptr;		// read position, readers only
+	bool					m_IsLatency		= false;		// FMADRING_FEATURE_LATENCY stamps
+	bool					m_IsMeta		= false;		// FMADRING_FEATURE_META parse on write, Meta() on read
+	bool					m_IsNoCache		= false;		// FMADRING_FEATURE_NOCACHE re-read the remote Get/Put
+	u64						m_BacklogPkt	= 0;			// resumed reader backlog
+	u64						m_LostPkt		= 0;			// resumed reader lost packets
+};
+
+}
+
+#endif
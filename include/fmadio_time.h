@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// calibrated TSC time base. the invariant TSC frequency is found once at
+// process startup and ns <-> tsc conversion is 32.32 fixed point
+//
+// expects the u8..u64 types, included from fmadio_packet.h
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#ifndef  __FMADIO_TIME_H__
+#define  __FMADIO_TIME_H__
+
+#include <stdlib.h>
+#include <time.h>
+
+//---------------------------------------------------------------------------------------------
+
+#define FMADTIME_FRAC				32					// fixed point fraction bits
+#define FMADTIME_CALIBRATE_NS		20000000ULL			// 20msec calibration window against the system clock
+
+#define FMADTIME_SOURCE_NONE		0					// not calibrated yet
+#define FMADTIME_SOURCE_CPUID		1					// CPUID leaf 0x15 crystal ratio
+#define FMADTIME_SOURCE_CLOCK		2					// measured against CLOCK_MONOTONIC_RAW
+#define FMADTIME_SOURCE_ENV			3					// forced with FMADIO_TSC_HZ
+
+typedef struct fFMADTime_t
+{
+	u64					TSCHz;							// TSC ticks per second
+	u64					NS2TSC;							// ticks per nsec in 32.32 fixed point
+	u64					TSC2NS;							// nsec per tick in 32.32 fixed point
+
+	u32					Source;							// where the frequency came from
+	bool				IsInvariant;					// cpu reports an invariant TSC
+
+} fFMADTime_t;
+
+static fFMADTime_t		s_FMADTime;
+
+//---------------------------------------------------------------------------------------------
+
+static inline volatile u64 rdtsc(void)
+{
+	u32 hi, lo;
+	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi) );
+	return (((u64)hi)<<32ULL) | (u64)lo;
+}
+
+static inline void FMADTime_CPUID(u32 Leaf, u32* pEAX, u32* pEBX, u32* pECX, u32* pEDX)
+{
+	__asm__ volatile("cpuid" : "=a"(*pEAX), "=b"(*pEBX), "=c"(*pECX), "=d"(*pEDX) : "a"(Leaf), "c"(0) );
+}
+
+static inline u64 FMADTime_ClockNS(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return (u64)t.tv_sec * 1000000000ULL + (u64)t.tv_nsec;
+}
+
+//---------------------------------------------------------------------------------------------
+// set the conversion factors from a tsc frequency
+
+static inline void FMADTime_SetHz(u64 TSCHz, u32 Source)
+{
+	s_FMADTime.TSCHz	= TSCHz;
+	s_FMADTime.NS2TSC	= (u64)( ((unsigned __int128)TSCHz << FMADTIME_FRAC) / 1000000000ULL );
+	s_FMADTime.TSC2NS	= (u64)( ((unsigned __int128)1000000000ULL << FMADTIME_FRAC) / TSCHz );
+	s_FMADTime.Source	= Source;
+}
+
+//---------------------------------------------------------------------------------------------
+// crystal clock * ratio as reported by the cpu, returns 0 when the leaf is missing
+// or does not report the crystal frequency (e.g. older parts and most VMs)
+
+static u64 FMADTime_HzCPUID(void)
+{
+	u32 eax, ebx, ecx, edx;
+
+	FMADTime_CPUID(0, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x15) return 0;
+
+	FMADTime_CPUID(0x15, &eax, &ebx, &ecx, &edx);
+	if ((eax == 0) || (ebx == 0) || (ecx == 0)) return 0;
+
+	return ((u64)ecx * (u64)ebx) / (u64)eax;
+}
+
+//---------------------------------------------------------------------------------------------
+// measure the tsc against the raw monotonic clock. each end point takes the
+// tightest of a few rdtsc/clock_gettime pairs so a preemption doesnt skew it
+
+static void FMADTime_Sample(u64* pTSC, u64* pNS)
+{
+	u64 Best = (u64)-1;
+	for (int i=0; i < 8; i++)
+	{
+		u64 TSC0	= rdtsc();
+		u64 NS		= FMADTime_ClockNS();
+		u64 TSC1	= rdtsc();
+		if (TSC1 - TSC0 < Best)
+		{
+			Best	= TSC1 - TSC0;
+			*pTSC	= TSC0 + (TSC1 - TSC0) / 2;
+			*pNS	= NS;
+		}
+	}
+}
+
+static u64 FMADTime_HzClock(void)
+{
+	u64 TSC0, NS0;
+	u64 TSC1, NS1;
+
+	FMADTime_Sample(&TSC0, &NS0);
+	while (FMADTime_ClockNS() - NS0 < FMADTIME_CALIBRATE_NS)
+	{
+		__asm__ volatile("pause");
+	}
+	FMADTime_Sample(&TSC1, &NS1);
+
+	return (u64)( ((unsigned __int128)(TSC1 - TSC0) * 1000000000ULL) / (NS1 - NS0) );
+}
+
+//---------------------------------------------------------------------------------------------
+// runs once at startup before main
+
+static void __attribute__((constructor)) FMADTime_Init(void)
+{
+	u32 eax, ebx, ecx, edx;
+
+	// invariant tsc bit
+	FMADTime_CPUID(0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000007)
+	{
+		FMADTime_CPUID(0x80000007, &eax, &ebx, &ecx, &edx);
+		s_FMADTime.IsInvariant = (edx >> 8) & 1;
+	}
+
+	// manual override
+	const char* Env = getenv("FMADIO_TSC_HZ");
+	if (Env && (strtoull(Env, NULL, 0) > 0))
+	{
+		FMADTime_SetHz(strtoull(Env, NULL, 0), FMADTIME_SOURCE_ENV);
+		return;
+	}
+
+	u64 Hz = FMADTime_HzCPUID();
+	if (Hz > 0)
+	{
+		FMADTime_SetHz(Hz, FMADTIME_SOURCE_CPUID);
+		return;
+	}
+
+	FMADTime_SetHz(FMADTime_HzClock(), FMADTIME_SOURCE_CLOCK);
+}
+
+static inline const char* FMADTime_SourceStr(void)
+{
+	switch (s_FMADTime.Source)
+	{
+	case FMADTIME_SOURCE_CPUID:	return "cpuid";
+	case FMADTIME_SOURCE_CLOCK:	return "clock";
+	case FMADTIME_SOURCE_ENV:	return "env";
+	}
+	return "none";
+}
+
+//---------------------------------------------------------------------------------------------
+
+static inline u64 ns2tsc(u64 ns)
+{
+	return (u64)( ((unsigned __int128)ns * s_FMADTime.NS2TSC) >> FMADTIME_FRAC );
+}
+static inline u64 tsc2ns(u64 tsc)
+{
+	return (u64)( ((unsigned __int128)tsc * s_FMADTime.TSC2NS) >> FMADTIME_FRAC );
+}
+
+static void ndelay(u64 ns)
+{
+	u64 NextTS = rdtsc() + ns2tsc(ns);
+	while (rdtsc() < NextTS)
+	{
+		__asm__ volatile("pause");
+		__asm__ volatile("pause");
+		__asm__ volatile("pause");
+		__asm__ volatile("pause");
+	}
+}
+
+#endif
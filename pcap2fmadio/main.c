@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdio.h>
@@ -15,6 +16,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
 
 #include "include/fmadio_packet.h"
 
@@ -45,6 +48,7 @@ typedef struct
 	s32	ReadBufferMax;
 
 	bool	Finished;		// read completed
+	bool	IsStream;		// input is a pipe/socket, reads may block
 
 	u64	TS;			// last TS processed
 
@@ -61,6 +65,13 @@ static inline PCAPFile_t* PCAP_Open(u64* PCAPTimeScale)
 	F->F 		= stdin;
 	F->Length 	= 1e15;
 
+	// live pipe (e.g. tcpdump -w -) can stall between packets
+	struct stat st;
+	if (fstat(fileno(F->F), &st) == 0)
+	{
+		F->IsStream = S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode);
+	}
+
 	// Note: always map as read-only. 
 	PCAPHeader_t Header1;
 
@@ -113,6 +124,23 @@ static inline PCAPFile_t* PCAP_Open(u64* PCAPTimeScale)
 	return F;
 }
 
+// true if the next read would block waiting for input
+static inline bool PCAP_IsIdle(PCAPFile_t* PCAP)
+{
+	if (!PCAP->IsStream) return false;
+
+#ifdef __GLIBC__
+	// still packets in the stdio buffer
+	if (PCAP->F->_IO_read_ptr < PCAP->F->_IO_read_end) return false;
+#endif
+
+	struct pollfd P;
+	P.fd		= fileno(PCAP->F);
+	P.events	= POLLIN;
+	P.revents	= 0;
+	return (poll(&P, 1, 0) == 0);
+}
+
 static inline PCAPPacket_t* PCAP_Read(PCAPFile_t* PCAP)
 {
 	int ret;
@@ -178,7 +206,37 @@ static void PrintHelp()
 		"\n"
 		"Options:\n"
 		"    -i <path to FMADIO ring file> (required)\n"
-		"    --cpu <integer> : pin the process to the specified CPU core\n");
+		"    --cpu <integer|auto> : pin the process to the specified CPU core, auto picks a core local to the rings NUMA node\n"
+		"    --numa <integer> : create the ring with its memory bound to the NUMA node and pre-faulted\n"
+		"    --batch <integer> : packets per ring publish (default 64, 1 for lowest latency)\n"
+		"    --packed : create the ring in the packed variable length format\n"
+		"    --depth <integer> : number of ring slots when creating the ring (power of 2, default 1024)\n"
+		"    --packed-size <integer> : packed ring data size in MB when creating the ring (power of 2, default 8)\n"
+		"    --hugepage <2M|1G> : create the ring with huge pages. 1G requires the ring on a hugetlbfs mount\n"
+		"    --multi-producer : create the ring so several producers can write to it at once\n"
+		"    --futex : create the ring so idle readers sleep on a futex instead of polling\n"
+		"    --meta : create the ring with per packet header metadata parsed once here for every reader\n"
+		"    --latency : create the ring with per packet TSC stamps so readers measure the ring latency\n"
+		"    --ring-set <integer> : write a set of rings <path>.0 .. <path>.N-1 sharded by a symmetric flow hash\n");
+}
+
+//---------------------------------------------------------------------------------------------
+// publish a burst and account for what the ring actually took. a timeout sends only part of
+// the burst, the rest is counted as dropped
+static void SendBurst(fFMADRingSet_t* Set, fFMADRingSendDesc_t* Desc, u32 DescCnt, u64* TotalPkt, u64* TotalByte, u64* TotalDrop)
+{
+	int ret = FMADPacket_SendSetBatch(Set, Desc, DescCnt);
+	u32 SendCnt = (ret < 0) ? 0 : ret;
+
+	// bytes are exact for a single ring, a ring set sends shard by shard
+	*TotalPkt 	+= SendCnt;
+	for (int i=0; i < SendCnt; i++) *TotalByte += Desc[i].LengthCapture;
+
+	if (SendCnt < DescCnt)
+	{
+		*TotalDrop += DescCnt - SendCnt;
+		fprintf(stderr, "ring send timeout, dropped %i of %i packets\n", DescCnt - SendCnt, DescCnt);
+	}
 }
 
 int main(int argc, char* argv[])
@@ -189,6 +247,14 @@ int main(int argc, char* argv[])
 	bool EnableEOFPacket	= true; 	// send EOF packet at the end of the file
 	bool SendEOFPacket		= false; 	// send an EOF packet only 
 	u64 TxTimeoutNS 		= 30e6;		// default to 30sec timeout
+	u32 BatchSize			= FMADRING_BATCH_MAX;	// number of packets published per ring update
+	u32 RingVersion			= FMADRING_VERSION;		// ring format to create
+	u64 RingDepth			= 0;					// slots in the ring, 0 for default/existing
+	u64 RingDataSize		= 0;					// packed ring bytes, 0 for default/existing
+	u64 RingPageSize		= 0;					// huge page size, 0 for regular pages/existing
+	u32 RingFeature			= 0;					// FMADRING_FEATURE_* to create the ring with
+	s32 RingNUMANode		= FMADRING_NUMA_NONE;	// NUMA node to bind the ring memory to
+	u32 RingSetCount		= 1;					// rings in the flow hashed ring set
 
 	for (int i = 0; i < argc; ++i)
 	{
@@ -216,7 +282,119 @@ int main(int argc, char* argv[])
 				fprintf(stderr, "argument `--cpu` expects a following integer argument");
 				return 1;
 			}
-			fprintf(stderr, "Will pin thread to CPU %i.\n", CPU);
+			CPU = (strcmp(argv[i + 1], "auto") == 0) ? FMADRING_CPU_AUTO : atoi(argv[i + 1]);
+			fprintf(stderr, "Will pin thread to CPU %s.\n", argv[i + 1]);
+			i += 1;
+		}
+		// ring memory on a specific NUMA node
+		else if (strcmp(argv[i], "--numa") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--numa` expects a following integer argument");
+				return 1;
+			}
+			RingNUMANode = atoi(argv[i + 1]);
+			fprintf(stderr, "Ring on NUMA node %i\n", RingNUMANode);
+			i += 1;
+		}
+		// number of packets per batched ring write
+		else if (strcmp(argv[i], "--batch") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--batch` expects a following integer argument");
+				return 1;
+			}
+			BatchSize = atoi(argv[i + 1]);
+			if (BatchSize < 1) 					BatchSize = 1;
+			if (BatchSize > FMADRING_BATCH_MAX) BatchSize = FMADRING_BATCH_MAX;
+
+			fprintf(stderr, "Batch size %i\n", BatchSize);
+			i += 1;
+		}
+		// create a packed variable length ring 
+		else if (strcmp(argv[i], "--packed") == 0)
+		{
+			fprintf(stderr, "Packed ring format\n");
+			RingVersion = FMADRING_VERSION2;
+		}
+		// ring depth when creating 
+		else if (strcmp(argv[i], "--depth") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--depth` expects a following integer argument");
+				return 1;
+			}
+			RingDepth = strtoull(argv[i + 1], NULL, 0);
+			fprintf(stderr, "Ring depth %lli\n", RingDepth);
+			i += 1;
+		}
+		// packed ring size when creating 
+		else if (strcmp(argv[i], "--packed-size") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--packed-size` expects a following integer argument");
+				return 1;
+			}
+			RingDataSize = strtoull(argv[i + 1], NULL, 0) * 1024 * 1024;
+			fprintf(stderr, "Packed ring size %lli MB\n", RingDataSize / (1024*1024));
+			i += 1;
+		}
+		// map the ring with huge pages
+		else if (strcmp(argv[i], "--hugepage") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--hugepage` expects a following 2M or 1G argument");
+				return 1;
+			}
+			if 		(strcmp(argv[i + 1], "2M") == 0) RingPageSize = FMADRING_HUGEPAGE_2MB;
+			else if (strcmp(argv[i + 1], "1G") == 0) RingPageSize = FMADRING_HUGEPAGE_1GB;
+			else
+			{
+				fprintf(stderr, "argument `--hugepage` expects 2M or 1G got [%s]\n", argv[i + 1]);
+				return 1;
+			}
+			fprintf(stderr, "Huge page size %lli\n", RingPageSize);
+			i += 1;
+		}
+		// other producers write to the same ring
+		else if (strcmp(argv[i], "--multi-producer") == 0)
+		{
+			fprintf(stderr, "Multiple producer ring\n");
+			RingFeature |= FMADRING_FEATURE_MPSC;
+		}
+		// readers block instead of poll
+		else if (strcmp(argv[i], "--futex") == 0)
+		{
+			fprintf(stderr, "Futex wait ring\n");
+			RingFeature |= FMADRING_FEATURE_FUTEX;
+		}
+		// parse headers once for all readers
+		else if (strcmp(argv[i], "--meta") == 0)
+		{
+			fprintf(stderr, "Packet metadata ring\n");
+			RingFeature |= FMADRING_FEATURE_META;
+		}
+		// measure write to receive latency
+		else if (strcmp(argv[i], "--latency") == 0)
+		{
+			fprintf(stderr, "Latency stamped ring\n");
+			RingFeature |= FMADRING_FEATURE_LATENCY;
+		}
+		// shard across a set of rings by flow
+		else if (strcmp(argv[i], "--ring-set") == 0)
+		{
+			if ((i + 1) >= argc)
+			{
+				fprintf(stderr, "argument `--ring-set` expects a following integer argument");
+				return 1;
+			}
+			RingSetCount = atoi(argv[i + 1]);
+			fprintf(stderr, "Ring set of %i rings\n", RingSetCount);
 			i += 1;
 		}
 		// disables sending the EOF packet down the ring
@@ -242,14 +420,6 @@ int main(int argc, char* argv[])
 	signal(SIGINT, (sighandler_t)signal_handler);
 	signal(SIGTERM, (sighandler_t)signal_handler);
 
-	if (CPU != -1)
-	{
-		cpu_set_t  mask;
-		CPU_ZERO(&mask);
-		CPU_SET(CPU, &mask);
-		sched_setaffinity(0, sizeof(mask), &mask);
-	}
-
 	if (RingPath == NULL)
 	{
 		fprintf(stderr, "Missing arguments `-i <path to FMADIO ring file>`\n");
@@ -259,16 +429,29 @@ int main(int argc, char* argv[])
 	// send an EOF only .e.g. after a number of pcaps have been sent
 	if (SendEOFPacket)
 	{
-		// open the ring
-		int PFD;
-		fFMADRingHeader_t* Ring;
-		int Result = FMADPacket_OpenTx(&PFD, &Ring, false, RingPath, false, TxTimeoutNS);
+		// open the ring, keeping whatever format it already has
+		fFMADRingConfig_t Config;
+		FMADPacket_ConfigDefault(&Config);
+		Config.Version		= 0;
+		Config.TimeoutNS	= TxTimeoutNS;
+		Config.Depth		= RingDepth;
+		Config.DataSize		= RingDataSize;
+		Config.HugePageSize	= RingPageSize;
+		Config.Feature		= RingFeature;
+		Config.NUMANode		= RingNUMANode;
+
+		fFMADRingSet_t Set;
+		int Result = FMADPacket_OpenTxSet(&Set, RingPath, RingSetCount, &Config);
 		if (Result < 0) return 3;
 
 		// send eof
-		FMADPacket_SendEOFV1(Ring, Ring->PutPktTS);
+		for (int i=0; i < Set.Count; i++)
+		{
+			fFMADRingHeader_t* Ring = Set.Ring[i];
+			FMADPacket_SendEOFV1(Ring, Ring->PutPktTS);
 
-		fprintf(stderr, "sent EOF packet only PuTS:%lli GetTS:%lli\n", Ring->PutPktTS, Ring->GetPktTS );
+			fprintf(stderr, "sent EOF packet only PuTS:%lli GetTS:%lli\n", Ring->PutPktTS, Ring->GetPktTS );
+		}
 		return 0;
 	}
 
@@ -278,31 +461,71 @@ int main(int argc, char* argv[])
 	if (PCAPFile == NULL)
 		return 2;
 
-	int PFD = -1;
-	fFMADRingHeader_t* Ring = NULL;
-	
-	int Result = FMADPacket_OpenTx(&PFD, &Ring, false, RingPath, false, TxTimeoutNS);
+	fFMADRingConfig_t Config;
+	FMADPacket_ConfigDefault(&Config);
+	Config.Version		= RingVersion;
+	Config.TimeoutNS	= TxTimeoutNS;
+	Config.Depth		= RingDepth;
+	Config.DataSize		= RingDataSize;
+	Config.HugePageSize	= RingPageSize;
+	Config.Feature		= RingFeature;
+	Config.NUMANode		= RingNUMANode;
+
+	// a set of 1 is the single ring at RingPath
+	fFMADRingSet_t Set;
+	int Result = FMADPacket_OpenTxSet(&Set, RingPath, RingSetCount, &Config);
 	if (Result < 0) return 3;
 
+	// pin once the ring exists so the cpu can be checked against its NUMA node
+	CPU = FMADPacket_NUMACPU(Set.Ring[0], CPU);
+	if (CPU != -1)
+	{
+		cpu_set_t  mask;
+		CPU_ZERO(&mask);
+		CPU_SET(CPU, &mask);
+		sched_setaffinity(0, sizeof(mask), &mask);
+	}
+
 	u64 TotalPkt 	= 0;
 	u64 TotalByte 	= 0;
+	u64 TotalDrop 	= 0;				// packets the ring did not take (timeout)
+
+	// pending burst of packets 
+	fFMADRingSendDesc_t Desc[FMADRING_BATCH_MAX];
+	u32 DescCnt		= 0;
 
 	u64 NextPrintTSC = rdtsc() + ns2tsc(1e9);
 	while (true)
 	{
+		// input is idle, publish the partial burst instead of holding
+		// it until the next packet arrives
+		if ((DescCnt > 0) && PCAP_IsIdle(PCAPFile))
+		{
+			SendBurst(&Set, Desc, DescCnt, &TotalPkt, &TotalByte, &TotalDrop);
+			DescCnt = 0;
+		}
+
 		// fetch from pcap file
 		PCAPPacket_t* Pkt = PCAP_Read(PCAPFile);
 
 		// error condition or end of the pcap 
 		if (Pkt == NULL)
 		{
+			// flush whats pending
+			if (DescCnt > 0)
+			{
+				SendBurst(&Set, Desc, DescCnt, &TotalPkt, &TotalByte, &TotalDrop);
+				DescCnt = 0;
+			}
+
 			// send EOF packet down the ring, this signals the peer to exit
 			if (EnableEOFPacket)
 			{
-				FMADPacket_SendEOFV1(Ring, PCAPFile->TS);
+				FMADPacket_SendSetEOF(&Set, PCAPFile->TS);
 			}
 
 			fprintf(stderr, "Reached end of PCAP file.\n");
+			fprintf(stderr, "TotalPacket:%16lli TotalByte:%16lli TotalDrop:%16lli\n", TotalPkt, TotalByte, TotalDrop);
 			return 0;
 		}
 
@@ -316,26 +539,33 @@ int main(int argc, char* argv[])
 			// convert timestamp to nanos
 			u64 TS = PCAP_TimeStamp(Pkt, TimeScale, 0 /* No time zone offset yet */);
 
-			// send down the ring
-			FMADPacket_SendV1(
-				Ring,
-				TS,
-				Pkt->LengthWire,
-				Pkt->LengthCapture,
-				(u32)0, 				// assume port 0 
-				(u32)0, 				// packet flag
-				(u64)0,					// no storage ID
-				Pkt + 1);
+			// queue it for the ring. the pcap packet buffer is not re-used 
+			// until 256 more packets have been read
+			fFMADRingSendDesc_t* D = &Desc[DescCnt++];
+			D->TS				= TS;
+			D->LengthWire		= Pkt->LengthWire;
+			D->LengthCapture	= Pkt->LengthCapture;
+			D->Port				= 0; 				// assume port 0 
+			D->Flag				= 0; 				// packet flag
+			D->StorageID		= 0;				// no storage ID
+			D->Payload			= Pkt + 1;
 
 			PCAPFile->TS = TS;
 		}
 
+		// send the burst down the ring
+		if (DescCnt >= BatchSize)
+		{
+			SendBurst(&Set, Desc, DescCnt, &TotalPkt, &TotalByte, &TotalDrop);
+			DescCnt = 0;
+		}
+
 		if (g_Verbose > 0)
 		{
 			u64 TSC = rdtsc();
 			if (TSC > NextPrintTSC)
 			{
-				fprintf(stderr, "TotalPacket:%16lli TotalByte:%16lli\n", TotalPkt, TotalByte);
+				fprintf(stderr, "TotalPacket:%16lli TotalByte:%16lli TotalDrop:%16lli\n", TotalPkt, TotalByte, TotalDrop);
 				NextPrintTSC = rdtsc() + ns2tsc(1e9);
 			}
 		}
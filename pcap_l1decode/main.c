@@ -23,6 +23,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
 
 #include "include/fmadio_packet.h"
 
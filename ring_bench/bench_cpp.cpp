@@ -0,0 +1,219 @@
+//-------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// ring micro benchmark runs of the C++ template API. same producer/consumer loops as the C
+// runs in main.c, with a template instance per depth, backoff and flow control setting
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+#include "include/fmadio_ring.hpp"
+
+#include "ring_bench.h"
+
+//------------------------------------------------------------------------------
+
+template <u64 Depth, typename Backoff, typename Flow>
+using BenchRing = fmad::Ring<sizeof(fFMADRingPacket_t), Depth, fmad::Policy<Backoff, Flow>>;
+
+template <u64 Depth, typename Backoff, typename Flow>
+static void* BenchProducer(BenchRun_t* Run)
+{
+	PinCPU(Run->CPUProducer);
+
+	// second mapping of the ring main.c created
+	BenchRing<Depth, Backoff, Flow> RING;
+	u32 Feature = 0;
+	if (Run->IsLatency) Feature |= FMADRING_FEATURE_LATENCY;
+	if (Run->IsNoCache) Feature |= FMADRING_FEATURE_NOCACHE;
+	if (RING.OpenTx((const char*)s_RINGPath, false, Feature) < 0)
+	{
+		fprintf(stderr, "failed to open FMAD Ring [%s]\n", s_RINGPath);
+		exit(-1);
+	}
+
+	fFMADRingSendDesc_t Desc[FMADRING_BATCH_MAX];
+	for (int i=0; i < FMADRING_BATCH_MAX; i++)
+	{
+		Desc[i].LengthWire		= Run->Size;
+		Desc[i].LengthCapture	= Run->Size;
+		Desc[i].Port			= 0;
+		Desc[i].Flag			= 0;
+		Desc[i].StorageID		= 0;
+		Desc[i].Payload			= s_Payload[i];
+	}
+
+	int PerfFD[BENCH_PERF_MAX];
+	BenchPerfStart(PerfFD);
+
+	Run->TSCStart = rdtsc();
+
+	u64 Pkt = 0;
+	while (Pkt < s_PktCnt)
+	{
+		// single packet send
+		if (Run->API == BENCH_API_CPPPEEK)
+		{
+			if (RING.Send(Pkt, Run->Size, Run->Size, 0, 0, 0, s_Payload[Pkt % FMADRING_BATCH_MAX]) < 0) break;
+			Pkt++;
+			continue;
+		}
+
+		// burst send
+		u32 Cnt = (s_PktCnt - Pkt < FMADRING_BATCH_MAX) ? s_PktCnt - Pkt : FMADRING_BATCH_MAX;
+		for (u32 i=0; i < Cnt; i++) Desc[i].TS = Pkt + i;
+
+		int ret = RING.SendBatch(Desc, Cnt);
+		if (ret > 0) Pkt += ret;
+		if (ret < (int)Cnt) break;
+	}
+
+	Run->TSCSendEnd	= rdtsc();
+	Run->SendPkt	= Pkt;
+	Run->SendByte	= Pkt * Run->Size;
+
+	BenchPerfStop(PerfFD, Run->PerfProducer);
+
+	while (!Run->IsDone)
+	{
+		if (RING.SendEOF(Pkt) < 0) break;
+		usleep(1000);
+	}
+
+	return NULL;
+}
+
+template <u64 Depth, typename Backoff, typename Flow>
+static void* BenchConsumer(BenchRun_t* Run)
+{
+	PinCPU(Run->CPUConsumer);
+
+	BenchRing<Depth, Backoff, Flow> RING;
+	if (RING.OpenRx((const char*)s_RINGPath, "ring_bench") < 0)
+	{
+		fprintf(stderr, "failed to open FMAD Ring [%s]\n", s_RINGPath);
+		exit(-1);
+	}
+
+	int PerfFD[BENCH_PERF_MAX];
+	BenchPerfStart(PerfFD);
+
+	Run->IsReady = true;
+
+	u64 Pkt		= 0;
+	u64 Byte	= 0;
+	while (true)
+	{
+		int ret = 0;
+		if (Run->API == BENCH_API_CPPPEEK)
+		{
+			fmad::Packet P;
+			ret = RING.Peek(P);
+			if (ret > 0)
+			{
+				const fFMADRingPacket_t* Slot = P.Slot();
+				BenchFilter(Run, &Slot, 1);
+			}
+
+			// re-written while held by a producer without flow control, counted as lost
+			if ((ret > 0) && RING.Release(P))
+			{
+				Pkt		+= 1;
+				Byte	+= ret;
+			}
+		}
+		else
+		{
+			fmad::Batch Batch;
+			ret = RING.Recv(Batch);
+			if (ret > 0)
+			{
+				const fFMADRingPacket_t* Slot[FMADRING_BATCH_MAX];
+				for (u32 i=0; i < Batch.size(); i++) Slot[i] = Batch[i].Slot();
+				BenchFilter(Run, Slot, Batch.size());
+
+				u64 LostByte = RING.Cursor()->LostByte;
+				u32 LostCnt = RING.Release(Batch);
+
+				Pkt		+= ret - LostCnt;
+				Byte	+= Batch.Byte() - (RING.Cursor()->LostByte - LostByte);
+			}
+		}
+
+		// EOF
+		if (ret < 0) break;
+
+		if (ret == 0) __asm__ volatile("pause");
+	}
+
+	Run->TSCRecvEnd	= rdtsc();
+	Run->RecvPkt	= Pkt;
+	Run->RecvByte	= Byte;
+	Run->LostPkt	= RING.Cursor()->LostPkt;
+
+	BenchPerfStop(PerfFD, Run->PerfConsumer);
+
+	sfence();
+	Run->IsDone		= true;
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+// template instance for a runs settings
+
+template <u64 Depth, typename Backoff>
+static void* BenchFlow(BenchRun_t* Run, bool IsProducer)
+{
+	if (Run->IsFlowControl)
+	{
+		return IsProducer ? BenchProducer<Depth, Backoff, fmad::FlowControl>(Run) : BenchConsumer<Depth, Backoff, fmad::FlowControl>(Run);
+	}
+	return IsProducer ? BenchProducer<Depth, Backoff, fmad::FlowOverwrite>(Run) : BenchConsumer<Depth, Backoff, fmad::FlowOverwrite>(Run);
+}
+
+template <u64 Depth>
+static void* BenchBackoff(BenchRun_t* Run, bool IsProducer)
+{
+	switch (Run->Backoff)
+	{
+	case BENCH_BACKOFF_SPIN:	return BenchFlow<Depth, fmad::BackoffSpin>(Run, IsProducer);
+	case BENCH_BACKOFF_FUTEX:	return BenchFlow<Depth, fmad::BackoffFutex>(Run, IsProducer);
+	}
+	return BenchFlow<Depth, fmad::BackoffPoll>(Run, IsProducer);
+}
+
+static void* BenchDepth(BenchRun_t* Run, bool IsProducer)
+{
+	switch ((s_Depth != 0) ? s_Depth : FMADRING_ENTRYCNT)
+	{
+	case 1024:		return BenchBackoff<1024>(Run, IsProducer);
+	case 4096:		return BenchBackoff<4096>(Run, IsProducer);
+	case 16384:		return BenchBackoff<16384>(Run, IsProducer);
+	case 65536:		return BenchBackoff<65536>(Run, IsProducer);
+	}
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+bool BenchCppDepth(u64 Depth)
+{
+	if (Depth == 0) Depth = FMADRING_ENTRYCNT;
+
+	return (Depth == 1024) || (Depth == 4096) || (Depth == 16384) || (Depth == 65536);
+}
+
+void* BenchProducerCpp(void* Arg)
+{
+	return BenchDepth((BenchRun_t*)Arg, true);
+}
+
+void* BenchConsumerCpp(void* Arg)
+{
+	return BenchDepth((BenchRun_t*)Arg, false);
+}
@@ -0,0 +1,822 @@
+//-------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// ring micro benchmark. runs a producer and a consumer thread over a real ring file and
+// sweeps the receive API, packet size, flow control, core placement, backoff mode, page size
+// and the cached remote Get/Put.
+// reports Mpps, Gbps, the write to receive latency percentiles and per thread cache miss
+// counters as a table or json
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+
+#include <linux/perf_event.h>
+
+#include "include/fmadio_packet.h"
+#include "include/fmadio_bpf.h"
+
+#include "ring_bench.h"
+
+//------------------------------------------------------------------------------
+
+static const char* s_APIName[BENCH_API_MAX]				= { "copy", "peek", "batch", "packed", "cpppeek", "cppbatch" };
+static const char* s_PlaceName[BENCH_PLACE_MAX]			= { "same", "smt", "core", "socket" };
+static const char* s_BackoffName[BENCH_BACKOFF_MAX]		= { "spin", "poll", "futex" };
+static const char* s_FlowName[2]						= { "off", "on" };
+static const char* s_PageName[BENCH_PAGE_MAX]			= { "off", "2M", "1G" };
+static const char* s_CacheName[2]						= { "on", "off" };
+static const char* s_LatencyName[2]					= { "off", "on" };
+static const u64   s_PageSize[BENCH_PAGE_MAX]			= { 0, FMADRING_HUGEPAGE_2MB, FMADRING_HUGEPAGE_1GB };
+
+// hardware counters each thread opens on itself, events the host does not have report -1
+typedef struct BenchPerf_t
+{
+	const char*		Name;
+	u32				Type;							// PERF_TYPE_*
+	u64				Config;							// event
+	bool			IsValid;						// opened on this host
+
+} BenchPerf_t;
+
+static BenchPerf_t s_Perf[BENCH_PERF_MAX] =
+{
+	{ "LLCMiss",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES },
+	{ "HITM",		PERF_TYPE_RAW,		0x04d2 },	// MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM skylake - icelake, --hitm for others
+	{ "dTLBMiss",	PERF_TYPE_HW_CACHE,	PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+u8*							s_RINGPath	= "/dev/shm/ring_bench";	// ring file the benchmark runs on
+static u8*					s_HugeTLBFS	= NULL;						// hugetlbfs mount huge page runs use, NULL the -i file
+u64							s_PktCnt	= 1000000;					// packets per run
+u64							s_Depth		= 0;						// ring slots, 0 for the default
+static int					s_CPU		= -1;						// producer cpu, -1 the first allowed cpu
+static fFMADBPF_t*			s_BPF		= NULL;						// filter the consumer runs on each packet, NULL for none
+static u64					s_TSCPair	= 0;						// cycles of back to back rdtsc, removed from filter timing
+
+u8							s_Payload[FMADRING_BATCH_MAX][BENCH_SIZE_MAX];	// packet data sent
+
+//------------------------------------------------------------------------------
+static void help(void)
+{
+	fprintf(stderr, "ring_bench <options>\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Producer/consumer micro benchmark of the FMADIO Ring buffer\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "ring_bench --size 64,1514,9000 --flow on,off --place same,core\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "   -i <path to ring file>           : ring file to run on (default /dev/shm/ring_bench)\n");
+	fprintf(stderr, "   -n <integer>                     : packets per run (default 1000000)\n");
+	fprintf(stderr, "   --depth <integer>                : ring slots (power of 2)\n");
+	fprintf(stderr, "   --cpu <integer>                  : producer cpu, placements are relative to it\n");
+	fprintf(stderr, "   --api <copy,peek,batch,packed,   : receive APIs to sweep (default copy,batch). cpp* are the\n");
+	fprintf(stderr, "          cpppeek,cppbatch>         : fmad::Ring template API, built for depth 1K,4K,16K,64K\n");
+	fprintf(stderr, "   --size <bytes,..>                : packet sizes to sweep (default 64 to 9000)\n");
+	fprintf(stderr, "   --flow <on,off>                  : flow control settings to sweep (default on,off)\n");
+	fprintf(stderr, "   --place <same,smt,core,socket>   : consumer placements to sweep (default all)\n");
+	fprintf(stderr, "   --backoff <spin,poll,futex>      : consumer wait modes to sweep (default poll)\n");
+	fprintf(stderr, "   --cache <on,off>                 : cached remote Get/Put settings to sweep (default on). off\n");
+	fprintf(stderr, "                                    : re-reads the other sides cache line every check\n");
+	fprintf(stderr, "   --no-cache                       : same as --cache off\n");
+	fprintf(stderr, "   --latency <on,off>               : latency stamp settings to sweep (default on). off measures\n");
+	fprintf(stderr, "                                    : throughput without the per packet rdtsc and histogram update\n");
+	fprintf(stderr, "   --hugepage <off,2M,1G>           : ring page sizes to sweep (default off). 2M is transparent huge\n");
+	fprintf(stderr, "                                    : pages on tmpfs, 1G needs --hugetlbfs\n");
+	fprintf(stderr, "   --hugetlbfs <mount>              : huge page runs put the ring in this hugetlbfs mount\n");
+	fprintf(stderr, "   --bpf <filter>                   : consumer runs the filter on every packet and reports the matches\n");
+	fprintf(stderr, "                                    : and ns per packet in it. packets are ethernet/ipv4/tcp, half to port 80\n");
+	fprintf(stderr, "   --hitm <raw event>               : cpu specific event counting loads that hit a line modified by\n");
+	fprintf(stderr, "                                    : another core (default 0x04d2, MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM)\n");
+	fprintf(stderr, "   --json                           : one json object per run\n");
+	fprintf(stderr, "\n");
+}
+
+//------------------------------------------------------------------------------
+// comma seperated list of names into indexes
+static int ParseList(const char* Arg, const char** Names, u32 NameCnt, u32* List, u32* pListCnt)
+{
+	char Str[256];
+	strncpy(Str, Arg, sizeof(Str) - 1);
+	Str[sizeof(Str) - 1] = 0;
+
+	u32 Cnt = 0;
+	for (char* Tok = strtok(Str, ","); Tok != NULL; Tok = strtok(NULL, ","))
+	{
+		int Index = -1;
+		for (int i=0; i < NameCnt; i++)
+		{
+			if (strcmp(Tok, Names[i]) == 0) Index = i;
+		}
+		if ((Index < 0) || (Cnt >= BENCH_LIST_MAX))
+		{
+			fprintf(stderr, "invalid value [%s]\n", Tok);
+			return -1;
+		}
+		List[Cnt++] = Index;
+	}
+	pListCnt[0] = Cnt;
+
+	return 0;
+}
+
+// comma seperated list of packet sizes
+static int ParseSize(const char* Arg, u32* List, u32* pListCnt)
+{
+	char Str[256];
+	strncpy(Str, Arg, sizeof(Str) - 1);
+	Str[sizeof(Str) - 1] = 0;
+
+	u32 Cnt = 0;
+	for (char* Tok = strtok(Str, ","); Tok != NULL; Tok = strtok(NULL, ","))
+	{
+		u32 Size = atoi(Tok);
+		if ((Size < 14) || (Size > BENCH_SIZE_MAX) || (Cnt >= BENCH_LIST_MAX))
+		{
+			fprintf(stderr, "invalid packet size [%s] 14 - %i\n", Tok, BENCH_SIZE_MAX);
+			return -1;
+		}
+		List[Cnt++] = Size;
+	}
+	pListCnt[0] = Cnt;
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// cpu topology from sysfs, -1 if not available
+static int CPUTopology(int CPU, const char* Name)
+{
+	char Path[256];
+	snprintf(Path, sizeof(Path), "/sys/devices/system/cpu/cpu%i/topology/%s", CPU, Name);
+
+	FILE* F = fopen(Path, "r");
+	if (F == NULL) return -1;
+
+	int Value = -1;
+	if (fscanf(F, "%i", &Value) != 1) Value = -1;
+	fclose(F);
+
+	return Value;
+}
+
+// consumer cpu for a placement relative to the producer cpu, -1 if the host has none
+static int PlaceCPU(u32 Place, int CPU)
+{
+	if (Place == BENCH_PLACE_SAME) return CPU;
+
+	cpu_set_t Mask;
+	CPU_ZERO(&Mask);
+	sched_getaffinity(0, sizeof(Mask), &Mask);
+
+	int Core	= CPUTopology(CPU, "core_id");
+	int Package	= CPUTopology(CPU, "physical_package_id");
+
+	for (int i=0; i < CPU_SETSIZE; i++)
+	{
+		if ((i == CPU) || !CPU_ISSET(i, &Mask)) continue;
+
+		bool IsSamePackage	= (CPUTopology(i, "physical_package_id") == Package);
+		bool IsSameCore		= IsSamePackage && (CPUTopology(i, "core_id") == Core);
+
+		if ((Place == BENCH_PLACE_SMT)		&&  IsSameCore)						return i;
+		if ((Place == BENCH_PLACE_CORE)		&&  IsSamePackage && !IsSameCore)	return i;
+		if ((Place == BENCH_PLACE_SOCKET)	&& !IsSamePackage)					return i;
+	}
+	return -1;
+}
+
+void PinCPU(int CPU)
+{
+	cpu_set_t Mask;
+	CPU_ZERO(&Mask);
+	CPU_SET(CPU, &Mask);
+	pthread_setaffinity_np(pthread_self(), sizeof(Mask), &Mask);
+}
+
+//------------------------------------------------------------------------------
+// per thread hardware counters, the calling thread only, user space only 
+
+static int PerfOpen(BenchPerf_t* P)
+{
+	struct perf_event_attr Attr;
+	memset(&Attr, 0, sizeof(Attr));
+	Attr.size			= sizeof(Attr);
+	Attr.type			= P->Type;
+	Attr.config			= P->Config;
+	Attr.disabled		= 1;
+	Attr.exclude_kernel	= 1;
+	Attr.exclude_hv		= 1;
+
+	return syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+}
+
+// which counters the host has, most vms have no pmu
+static void PerfProbe(void)
+{
+	for (int i=0; i < BENCH_PERF_MAX; i++)
+	{
+		int fd = PerfOpen(&s_Perf[i]);
+		s_Perf[i].IsValid = (fd >= 0);
+		if (fd < 0)
+		{
+			fprintf(stderr, "perf counter %s type %i config 0x%llx not available errno:%i %s, reported as -1\n", s_Perf[i].Name, s_Perf[i].Type, s_Perf[i].Config, errno, strerror(errno));
+			continue;
+		}
+		close(fd);
+	}
+}
+
+void BenchPerfStart(int* PerfFD)
+{
+	for (int i=0; i < BENCH_PERF_MAX; i++)
+	{
+		PerfFD[i] = s_Perf[i].IsValid ? PerfOpen(&s_Perf[i]) : -1;
+		if (PerfFD[i] < 0) continue;
+
+		ioctl(PerfFD[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(PerfFD[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void BenchPerfStop(int* PerfFD, s64* Count)
+{
+	for (int i=0; i < BENCH_PERF_MAX; i++)
+	{
+		Count[i] = -1;
+		if (PerfFD[i] < 0) continue;
+
+		ioctl(PerfFD[i], PERF_EVENT_IOC_DISABLE, 0);
+
+		u64 Value = 0;
+		if (read(PerfFD[i], &Value, sizeof(Value)) == sizeof(Value)) Count[i] = Value;
+		close(PerfFD[i]);
+	}
+}
+
+// --bpf filter over received packets. timed per burst less the cost of reading the tsc, 
+// which on a vm can be as much as the filter
+void BenchFilter(BenchRun_t* Run, const fFMADRingPacket_t* const* Pkt, u32 Cnt)
+{
+	if (s_BPF == NULL) return;
+
+	u64 Match = 0;
+
+	u64 TSC0 = rdtsc();
+	for (int i=0; i < Cnt; i++) Match += FMADBPF_Packet(s_BPF, Pkt[i]);
+	u64 dTSC = rdtsc() - TSC0;
+
+	Run->FilterCycle	+= (dTSC > s_TSCPair) ? dTSC - s_TSCPair : 0;
+	Run->FilterPkt		+= Cnt;
+	Run->MatchPkt		+= Match;
+}
+
+// ethernet / ipv4 / tcp headers so a --bpf filter walks the whole program, even payloads
+// to port 80 odd to port 443
+static void BenchHeader(u8* Pkt, u32 Index)
+{
+	static const u8 Header[54] =
+	{
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55,		0x00, 0x66, 0x77, 0x88, 0x99, 0xaa,		0x08, 0x00,
+		0x45, 0x00, 0x00, 0x28, 0x00, 0x00, 0x40, 0x00, 0x40, 0x06, 0x00, 0x00,
+		0x0a, 0x00, 0x00, 0x01,					0x0a, 0x00, 0x00, 0x02,
+		0x04, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+	};
+	memcpy(Pkt, Header, sizeof(Header));
+
+	// source port per payload, destination 80 or 443
+	Pkt[34] = 0x04 + (Index >> 8);
+	Pkt[35] = Index;
+	Pkt[36] = (Index & 1) ? 0x01 : 0x00;
+	Pkt[37] = (Index & 1) ? 0xbb : 0x50;
+}
+
+//------------------------------------------------------------------------------
+// sends s_PktCnt packets then EOF markers until the consumer has seen one. without flow
+// control an EOF can be dropped or lapped so it is repeated
+
+static void* BenchProducer(void* Arg)
+{
+	BenchRun_t* Run = (BenchRun_t*)Arg;
+	fFMADRingHeader_t* RING = Run->RING;
+
+	if (Run->API >= BENCH_API_CPPPEEK) return BenchProducerCpp(Arg);
+
+	PinCPU(Run->CPUProducer);
+
+	fFMADRingSendDesc_t Desc[FMADRING_BATCH_MAX];
+	for (int i=0; i < FMADRING_BATCH_MAX; i++)
+	{
+		Desc[i].LengthWire		= Run->Size;
+		Desc[i].LengthCapture	= Run->Size;
+		Desc[i].Port			= 0;
+		Desc[i].Flag			= 0;
+		Desc[i].StorageID		= 0;
+		Desc[i].Payload			= s_Payload[i];
+	}
+
+	int PerfFD[BENCH_PERF_MAX];
+	BenchPerfStart(PerfFD);
+
+	Run->TSCStart = rdtsc();
+
+	u64 Pkt = 0;
+	while (Pkt < s_PktCnt)
+	{
+		// single packet send
+		if ((Run->API == BENCH_API_COPY) || (Run->API == BENCH_API_PEEK))
+		{
+			if (FMADPacket_SendV1(RING, Pkt, Run->Size, Run->Size, 0, 0, 0, s_Payload[Pkt % FMADRING_BATCH_MAX]) < 0) break;
+			Pkt++;
+			continue;
+		}
+
+		// burst send
+		u32 Cnt = (s_PktCnt - Pkt < FMADRING_BATCH_MAX) ? s_PktCnt - Pkt : FMADRING_BATCH_MAX;
+		for (int i=0; i < Cnt; i++) Desc[i].TS = Pkt + i;
+
+		// without flow control a full packed ring drops the rest of the burst, they count as 
+		// sent and lost. with it a short count is a timeout part way through
+		int ret = FMADPacket_SendBatch(RING, Desc, Cnt);
+		if (ret < 0) break;
+		if (Run->IsFlowControl && (ret < Cnt))
+		{
+			Pkt += ret;
+			break;
+		}
+		Pkt += Cnt;
+	}
+
+	Run->TSCSendEnd	= rdtsc();
+	Run->SendPkt	= Pkt;
+	Run->SendByte	= Pkt * Run->Size;
+
+	BenchPerfStop(PerfFD, Run->PerfProducer);
+
+	while (!Run->IsDone)
+	{
+		if (FMADPacket_SendEOFV1(RING, Pkt) < 0) break;
+		usleep(1000);
+	}
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+// receives until EOF with its own mapping of the ring
+
+static void* BenchConsumer(void* Arg)
+{
+	BenchRun_t* Run = (BenchRun_t*)Arg;
+
+	if (Run->API >= BENCH_API_CPPPEEK) return BenchConsumerCpp(Arg);
+
+	PinCPU(Run->CPUConsumer);
+
+	// copy API reads as the default reader
+	int fd;
+	fFMADRingHeader_t* RING;
+	fFMADRingCursor_t* C;
+	if (FMADPacket_OpenRxCursor(&fd, &RING, &C, s_RINGPath, (Run->API == BENCH_API_COPY) ? "" : "ring_bench") < 0)
+	{
+		fprintf(stderr, "failed to open FMAD Ring [%s]\n", s_RINGPath);
+		exit(-1);
+	}
+
+	// copy API receives into a slot sized buffer so the filter reads it the same way
+	fFMADRingPacket_t* Copy = malloc(sizeof(fFMADRingPacket_t));
+	bool IsWait = (Run->Backoff != BENCH_BACKOFF_SPIN);
+
+	int PerfFD[BENCH_PERF_MAX];
+	BenchPerfStart(PerfFD);
+
+	Run->IsReady = true;
+
+	u64 Pkt		= 0;
+	u64 Byte	= 0;
+	while (true)
+	{
+		int ret = 0;
+		if (Run->API == BENCH_API_COPY)
+		{
+			u32 LengthCapture = 0;
+			u32 LengthWire = 0;
+			ret = FMADPacket_RecvV1a(RING, IsWait, NULL, &LengthWire, &LengthCapture, NULL, NULL, NULL, Copy->Payload);
+			if (ret > 0)
+			{
+				Copy->LengthWire	= LengthWire;
+				Copy->LengthCapture	= LengthCapture;
+				BenchFilter(Run, (const fFMADRingPacket_t**)&Copy, 1);
+
+				Pkt		+= 1;
+				Byte	+= LengthCapture;
+			}
+		}
+		else if (Run->API == BENCH_API_PEEK)
+		{
+			const fFMADRingPacket_t* P = NULL;
+			ret = FMADPacket_RecvPeekCursor(RING, C, IsWait, &P);
+			if (ret > 0) BenchFilter(Run, &P, 1);
+
+			// re-written while held by a producer without flow control, counted as lost
+			if ((ret > 0) && FMADPacket_RecvReleaseCursor(RING, C, P))
+			{
+				Pkt		+= 1;
+				Byte	+= ret;
+			}
+		}
+		else
+		{
+			fFMADRingBatch_t Batch;
+			ret = FMADPacket_RecvBatchCursor(RING, C, IsWait, &Batch, FMADRING_BATCH_MAX);
+			if (ret > 0)
+			{
+				BenchFilter(Run, Batch.Pkt, ret);
+
+				u64 LostByte = C->LostByte;
+				u32 LostCnt = FMADPacket_RecvBatchReleaseCursor(RING, C, &Batch);
+
+				Pkt		+= ret - LostCnt;
+				Byte	+= Batch.Byte - (C->LostByte - LostByte);
+			}
+		}
+
+		// EOF
+		if (ret < 0) break;
+
+		if (ret == 0) __asm__ volatile("pause");
+	}
+
+	Run->TSCRecvEnd	= rdtsc();
+	Run->RecvPkt	= Pkt;
+	Run->RecvByte	= Byte;
+	Run->LostPkt	= C->LostPkt;
+
+	BenchPerfStop(PerfFD, Run->PerfConsumer);
+
+	sfence();
+	Run->IsDone		= true;
+
+	FMADPacket_CursorDetach(RING, C);
+	munmap(RING, FMADPacket_MapSize(RING));
+	close(fd);
+	free(Copy);
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+// one run on a freshly reset ring
+
+static int BenchRun(BenchRun_t* Run)
+{
+	fFMADRingConfig_t Config;
+	FMADPacket_ConfigDefault(&Config);
+
+	Config.Version			= (Run->API == BENCH_API_PACKED) ? FMADRING_VERSION2 : FMADRING_VERSION;
+	Config.IsFlowControl	= Run->IsFlowControl;
+	Config.TimeoutNS		= 60e9;
+	Config.Feature			= 0;
+	Config.HugePageSize		= s_PageSize[Run->Page];
+	if (Run->Backoff == BENCH_BACKOFF_FUTEX) Config.Feature |= FMADRING_FEATURE_FUTEX;
+	if (Run->IsNoCache) Config.Feature |= FMADRING_FEATURE_NOCACHE;
+	if (Run->IsLatency) Config.Feature |= FMADRING_FEATURE_LATENCY;
+	if (s_Depth != 0) Config.Depth = s_Depth;
+
+	int fd;
+	if (FMADPacket_OpenTxConfig(&fd, &Run->RING, true, s_RINGPath, &Config) < 0)
+	{
+		fprintf(stderr, "failed to create FMAD Ring [%s]\n", s_RINGPath);
+		return -1;
+	}
+
+	pthread_t Consumer;
+	pthread_t Producer;
+
+	pthread_create(&Consumer, NULL, BenchConsumer, Run);
+	while (!Run->IsReady) usleep(100);
+
+	pthread_create(&Producer, NULL, BenchProducer, Run);
+
+	pthread_join(Producer, NULL);
+	pthread_join(Consumer, NULL);
+
+	// packets the consumer skipped, or the producer dropped
+	if (!Run->IsFlowControl) Run->LostPkt = Run->SendPkt - Run->RecvPkt;
+
+	return fd;
+}
+
+//------------------------------------------------------------------------------
+
+static void BenchPrint(BenchRun_t* Run, fFMADRingHeader_t* RING, bool IsJSON)
+{
+	double RecvNS	= tsc2ns(Run->TSCRecvEnd - Run->TSCStart);
+	double SendNS	= tsc2ns(Run->TSCSendEnd - Run->TSCStart);
+
+	double SendMpps	= (Run->SendPkt * 1e3) / SendNS;
+	double RecvMpps	= (Run->RecvPkt * 1e3) / RecvNS;
+	double RecvGbps	= (Run->RecvByte * 8.0) / RecvNS;
+
+	// -1 when the packets were not stamped
+	s64 P50			= Run->IsLatency ? FMADPacket_LatPercentile(RING, 50.0) : -1;
+	s64 P99			= Run->IsLatency ? FMADPacket_LatPercentile(RING, 99.0) : -1;
+	s64 P999		= Run->IsLatency ? FMADPacket_LatPercentile(RING, 99.9) : -1;
+	s64 LatMax		= Run->IsLatency ? RING->LatMax : -1;
+
+	// events per packet sent, both threads
+	double PerfPkt[BENCH_PERF_MAX];
+	for (int i=0; i < BENCH_PERF_MAX; i++)
+	{
+		bool IsValid = (Run->PerfProducer[i] >= 0) && (Run->PerfConsumer[i] >= 0) && (Run->SendPkt > 0);
+		PerfPkt[i] = IsValid ? (double)(Run->PerfProducer[i] + Run->PerfConsumer[i]) / Run->SendPkt : -1;
+	}
+
+	double FilterNS	= (Run->FilterPkt == 0) ? 0 : (Run->FilterCycle * 1e9) / (s_FMADTime.TSCHz * Run->FilterPkt);
+
+	if (IsJSON)
+	{
+		printf("{\"api\":\"%s\",", 		s_APIName[Run->API]);
+		printf("\"size\":%i,", 			Run->Size);
+		printf("\"flow\":\"%s\",", 		s_FlowName[Run->IsFlowControl]);
+		printf("\"place\":\"%s\",", 	s_PlaceName[Run->Place]);
+		printf("\"backoff\":\"%s\",", 	s_BackoffName[Run->Backoff]);
+		printf("\"page\":\"%s\",", 		s_PageName[Run->Page]);
+		printf("\"cache\":\"%s\",", 		s_CacheName[Run->IsNoCache]);
+		printf("\"latency\":\"%s\",", 	s_LatencyName[Run->IsLatency]);
+		printf("\"PageSize\":%lli,", 	FMADPacket_PageSize(RING));
+		printf("\"cpu\":[%i,%i],", 		Run->CPUProducer, Run->CPUConsumer);
+		printf("\"SendPkt\":%lli,", 	Run->SendPkt);
+		printf("\"RecvPkt\":%lli,", 	Run->RecvPkt);
+		printf("\"LostPkt\":%lli,", 	Run->LostPkt);
+		printf("\"SendMpps\":%.3f,", 	SendMpps);
+		printf("\"RecvMpps\":%.3f,", 	RecvMpps);
+		printf("\"RecvGbps\":%.3f,", 	RecvGbps);
+		printf("\"LatP50NS\":%lli,", 	P50);
+		printf("\"LatP99NS\":%lli,", 	P99);
+		printf("\"LatP999NS\":%lli,", 	P999);
+		printf("\"LatMaxNS\":%lli,", 	LatMax);
+		printf("\"PutStallCnt\":%lli,", RING->PutStallCnt);
+		printf("\"GetStallCnt\":%lli",	RING->GetStallCnt);
+		for (int i=0; i < BENCH_PERF_MAX; i++) printf(",\"%s\":[%lli,%lli]", s_Perf[i].Name, Run->PerfProducer[i], Run->PerfConsumer[i]);
+		if (s_BPF != NULL)
+		{
+			printf(",\"MatchPkt\":%lli,", Run->MatchPkt);
+			printf("\"BPFNS\":%.2f", 	FilterNS);
+		}
+		printf("}\n");
+	}
+	else
+	{
+		printf("%-8s %5i %4s %6s %5s %4s %5s %3s %3i %3i %9.3f %9.3f %8.3f %10lli",
+			s_APIName[Run->API],
+			Run->Size,
+			s_FlowName[Run->IsFlowControl],
+			s_PlaceName[Run->Place],
+			s_BackoffName[Run->Backoff],
+			s_PageName[Run->Page],
+			s_CacheName[Run->IsNoCache],
+			s_LatencyName[Run->IsLatency],
+			Run->CPUProducer,
+			Run->CPUConsumer,
+			SendMpps,
+			RecvMpps,
+			RecvGbps,
+			Run->LostPkt);
+		if (Run->IsLatency)	printf(" %10.3f %10.3f %10.3f %10.3f", P50 / 1e3, P99 / 1e3, P999 / 1e3, LatMax / 1e3);
+		else				printf(" %10s %10s %10s %10s", "-", "-", "-", "-");
+		for (int i=0; i < BENCH_PERF_MAX; i++)
+		{
+			if (PerfPkt[i] < 0)	printf(" %9s", "-");
+			else				printf(" %9.3f", PerfPkt[i]);
+		}
+		if (s_BPF != NULL) printf(" %10lli %8.2f", Run->MatchPkt, FilterNS);
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	u32 APIList[BENCH_LIST_MAX]		= { BENCH_API_COPY, BENCH_API_BATCH };
+	u32 APICnt						= 2;
+	u32 SizeList[BENCH_LIST_MAX]	= { 64, 128, 256, 512, 1024, 1514, 4096, 9000 };
+	u32 SizeCnt						= 8;
+	u32 FlowList[BENCH_LIST_MAX]	= { 1, 0 };
+	u32 FlowCnt						= 2;
+	u32 PlaceList[BENCH_LIST_MAX]	= { BENCH_PLACE_SAME, BENCH_PLACE_SMT, BENCH_PLACE_CORE, BENCH_PLACE_SOCKET };
+	u32 PlaceCnt					= 4;
+	u32 BackoffList[BENCH_LIST_MAX]	= { BENCH_BACKOFF_POLL };
+	u32 BackoffCnt					= 1;
+	u32 PageList[BENCH_LIST_MAX]	= { BENCH_PAGE_OFF };
+	u32 PageCnt						= 1;
+	u32 CacheList[BENCH_LIST_MAX]	= { 0 };
+	u32 CacheCnt					= 1;
+	u32 LatencyList[BENCH_LIST_MAX]	= { 1 };
+	u32 LatencyCnt					= 1;
+	bool IsJSON						= false;
+
+	for (int i=1; i < argc; i++)
+	{
+		bool IsArg = (i + 1) < argc;
+
+		if ((strcmp(argv[i], "-i") == 0) && IsArg)
+		{
+			s_RINGPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "-n") == 0) && IsArg)
+		{
+			s_PktCnt = strtoull(argv[++i], NULL, 0);
+		}
+		else if ((strcmp(argv[i], "--depth") == 0) && IsArg)
+		{
+			s_Depth = strtoull(argv[++i], NULL, 0);
+		}
+		else if ((strcmp(argv[i], "--cpu") == 0) && IsArg)
+		{
+			s_CPU = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--api") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_APIName, BENCH_API_MAX, APIList, &APICnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--size") == 0) && IsArg)
+		{
+			if (ParseSize(argv[++i], SizeList, &SizeCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--flow") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_FlowName, 2, FlowList, &FlowCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--place") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_PlaceName, BENCH_PLACE_MAX, PlaceList, &PlaceCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--backoff") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_BackoffName, BENCH_BACKOFF_MAX, BackoffList, &BackoffCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--bpf") == 0) && IsArg)
+		{
+			s_BPF = FMADBPF_Compile(argv[++i]);
+			if (s_BPF == NULL) return -1;
+		}
+		else if ((strcmp(argv[i], "--cache") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_CacheName, 2, CacheList, &CacheCnt) < 0) return -1;
+		}
+		else if (strcmp(argv[i], "--no-cache") == 0)
+		{
+			CacheList[0]	= 1;
+			CacheCnt		= 1;
+		}
+		else if ((strcmp(argv[i], "--latency") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_LatencyName, 2, LatencyList, &LatencyCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--hugepage") == 0) && IsArg)
+		{
+			if (ParseList(argv[++i], s_PageName, BENCH_PAGE_MAX, PageList, &PageCnt) < 0) return -1;
+		}
+		else if ((strcmp(argv[i], "--hugetlbfs") == 0) && IsArg)
+		{
+			s_HugeTLBFS = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--hitm") == 0) && IsArg)
+		{
+			s_Perf[BENCH_PERF_HITM].Config = strtoull(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--json") == 0)
+		{
+			IsJSON = true;
+		}
+		else if (strcmp(argv[i], "--help") == 0)
+		{
+			help();
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option [%s]\n", argv[i]);
+			help();
+			return -1;
+		}
+	}
+
+	// producer on the first cpu we are allowed on
+	if (s_CPU < 0)
+	{
+		cpu_set_t Mask;
+		CPU_ZERO(&Mask);
+		sched_getaffinity(0, sizeof(Mask), &Mask);
+		for (s_CPU = 0; (s_CPU < CPU_SETSIZE) && !CPU_ISSET(s_CPU, &Mask); s_CPU++);
+	}
+
+	// something other than zeros
+	for (int i=0; i < FMADRING_BATCH_MAX; i++)
+	{
+		for (int j=0; j < BENCH_SIZE_MAX; j++) s_Payload[i][j] = i + j;
+		if (s_BPF != NULL) BenchHeader(s_Payload[i], i);
+	}
+
+	PerfProbe();
+
+	// ring file per page type
+	u8* RINGPath = s_RINGPath;
+	u8 HugeTLBPath[256];
+	snprintf(HugeTLBPath, sizeof(HugeTLBPath), "%s/ring_bench", (s_HugeTLBFS != NULL) ? (char*)s_HugeTLBFS : "");
+
+	// cheapest back to back tsc read
+	s_TSCPair = (u64)-1;
+	for (int i=0; i < 1000; i++)
+	{
+		u64 TSC0 = rdtsc();
+		u64 dTSC = rdtsc() - TSC0;
+		if (dTSC < s_TSCPair) s_TSCPair = dTSC;
+	}
+
+	fprintf(stderr, "ring_bench %s %lli pkts per run, TSC %.3f GHz (%s)\n", s_RINGPath, s_PktCnt, s_FMADTime.TSCHz / 1e9, FMADTime_SourceStr());
+
+	if (!IsJSON)
+	{
+		printf("%-8s %5s %4s %6s %5s %4s %5s %3s %3s %3s %9s %9s %8s %10s %10s %10s %10s %10s",
+			"api", "size", "flow", "place", "wait", "page", "cache", "lat", "tx", "rx", "TxMpps", "RxMpps", "RxGbps", "Lost", "p50 us", "p99 us", "p99.9 us", "max us");
+		printf(" %9s %9s %9s", "LLC/pkt", "HITM/pkt", "dTLB/pkt");
+		if (s_BPF != NULL) printf(" %10s %8s", "Match", "bpf ns");
+		printf("\n");
+	}
+
+	for (int p=0; p < PlaceCnt; p++)
+	{
+		int CPUConsumer = PlaceCPU(PlaceList[p], s_CPU);
+		if (CPUConsumer < 0)
+		{
+			fprintf(stderr, "no cpu for placement %s relative to cpu %i, skipped\n", s_PlaceName[PlaceList[p]], s_CPU);
+			continue;
+		}
+
+		for (int a=0; a < APICnt; a++)
+		for (int b=0; b < BackoffCnt; b++)
+		for (int g=0; g < PageCnt; g++)
+		for (int c=0; c < CacheCnt; c++)
+		for (int l=0; l < LatencyCnt; l++)
+		for (int f=0; f < FlowCnt; f++)
+		for (int s=0; s < SizeCnt; s++)
+		{
+			if ((APIList[a] >= BENCH_API_CPPPEEK) && !BenchCppDepth(s_Depth))
+			{
+				if ((b == 0) && (g == 0) && (c == 0) && (l == 0) && (f == 0) && (s == 0)) fprintf(stderr, "%s not built for depth %lli, skipped\n", s_APIName[APIList[a]], s_Depth);
+				continue;
+			}
+
+			// huge page runs on the hugetlbfs mount if there is one
+			s_RINGPath = ((PageList[g] != BENCH_PAGE_OFF) && (s_HugeTLBFS != NULL)) ? HugeTLBPath : RINGPath;
+
+			BenchRun_t Run;
+			memset(&Run, 0, sizeof(Run));
+
+			Run.API				= APIList[a];
+			Run.Size			= SizeList[s];
+			Run.IsFlowControl	= FlowList[f];
+			Run.Place			= PlaceList[p];
+			Run.Backoff			= BackoffList[b];
+			Run.Page			= PageList[g];
+			Run.IsNoCache		= CacheList[c];
+			Run.IsLatency		= LatencyList[l];
+			Run.CPUProducer		= s_CPU;
+			Run.CPUConsumer		= CPUConsumer;
+
+			int fd = BenchRun(&Run);
+			if (fd < 0) return -1;
+
+			BenchPrint(&Run, Run.RING, IsJSON);
+
+			munmap(Run.RING, FMADPacket_MapSize(Run.RING));
+			close(fd);
+		}
+	}
+	unlink(RINGPath);
+	if (s_HugeTLBFS != NULL) unlink(HugeTLBPath);
+
+	return 0;
+}
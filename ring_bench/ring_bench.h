@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------------------------------------------------
+//
+// Copyright (c) 2021-2022, fmad engineering group
+//
+// LICENSE: refer to https://github.com/fmadio/platform/blob/main/LICENSE.md
+//
+// ring micro benchmark, shared between the C driver and the C++ template API runs
+//
+//-------------------------------------------------------------------------------------------------------------------
+
+#ifndef  __RING_BENCH_H__
+#define  __RING_BENCH_H__
+
+#define BENCH_API_COPY			0				// FMADPacket_SendV1 / FMADPacket_RecvV1a
+#define BENCH_API_PEEK			1				// FMADPacket_SendV1 / FMADPacket_RecvPeekCursor zero copy
+#define BENCH_API_BATCH			2				// FMADPacket_SendBatch / FMADPacket_RecvBatchCursor
+#define BENCH_API_PACKED		3				// batch on a FMADRING_VERSION2 packed ring
+#define BENCH_API_CPPPEEK		4				// fmad::Ring Send / Peek, include/fmadio_ring.hpp
+#define BENCH_API_CPPBATCH		5				// fmad::Ring SendBatch / Recv
+#define BENCH_API_MAX			6
+
+#define BENCH_PLACE_SAME		0				// producer and consumer on the same cpu
+#define BENCH_PLACE_SMT			1				// SMT sibling of the same core
+#define BENCH_PLACE_CORE		2				// another core of the same socket
+#define BENCH_PLACE_SOCKET		3				// a core on another socket
+#define BENCH_PLACE_MAX			4
+
+#define BENCH_BACKOFF_SPIN		0				// consumer polls without waiting
+#define BENCH_BACKOFF_POLL		1				// blocking receive, ndelay then usleep backoff
+#define BENCH_BACKOFF_FUTEX		2				// blocking receive, FMADRING_FEATURE_FUTEX sleep
+#define BENCH_BACKOFF_MAX		3
+
+#define BENCH_PAGE_OFF			0				// regular pages
+#define BENCH_PAGE_2M			1				// FMADRING_HUGEPAGE_2MB, transparent huge pages or hugetlbfs
+#define BENCH_PAGE_1G			2				// FMADRING_HUGEPAGE_1GB, hugetlbfs only
+#define BENCH_PAGE_MAX			3
+
+#define BENCH_PERF_LLC			0				// last level cache misses
+#define BENCH_PERF_HITM			1				// loads hitting a line modified by another core, raw event
+#define BENCH_PERF_DTLB			2				// dTLB load misses
+#define BENCH_PERF_MAX			3
+
+#define BENCH_SIZE_MAX			9216			// largest packet swept
+#define BENCH_LIST_MAX			16				// max values per swept option
+
+typedef struct BenchRun_t
+{
+	u32					API;						// BENCH_API_*
+	u32					Size;						// capture bytes per packet
+	u32					IsFlowControl;				// producer waits for the consumer
+	u32					Place;						// BENCH_PLACE_*
+	u32					Backoff;					// BENCH_BACKOFF_*
+	u32					Page;						// BENCH_PAGE_*
+	u32					IsNoCache;					// FMADRING_FEATURE_NOCACHE, no cached Get/Put
+	u32					IsLatency;					// FMADRING_FEATURE_LATENCY, packets stamped for the percentiles
+
+	int					CPUProducer;				// cpu the producer is pinned to
+	int					CPUConsumer;				// cpu the consumer is pinned to
+
+	fFMADRingHeader_t*	RING;						// producers mapping
+	volatile bool		IsReady;					// consumer attached
+	volatile bool		IsDone;						// consumer saw EOF
+
+	u64					TSCStart;					// producer started
+	u64					TSCSendEnd;					// producer sent the last packet
+	u64					TSCRecvEnd;					// consumer received EOF
+
+	u64					SendPkt;					// packets sent
+	u64					SendByte;
+	u64					RecvPkt;					// packets received
+	u64					RecvByte;
+	u64					LostPkt;					// sent but never received, no flow control only
+
+	u64					MatchPkt;					// received packets the --bpf filter matched
+	u64					FilterPkt;					// received packets the filter ran on
+	u64					FilterCycle;				// cycles spent in the filter
+
+	s64					PerfProducer[BENCH_PERF_MAX];	// producer thread hardware counters, -1 not available
+	s64					PerfConsumer[BENCH_PERF_MAX];	// consumer thread hardware counters, -1 not available
+
+} BenchRun_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern u8*				s_RINGPath;					// ring file the benchmark runs on
+extern u64				s_PktCnt;					// packets per run
+extern u64				s_Depth;					// ring slots, 0 for the default
+extern u8				s_Payload[FMADRING_BATCH_MAX][BENCH_SIZE_MAX];	// packet data sent
+
+void					PinCPU(int CPU);
+void					BenchPerfStart(int* PerfFD);
+void					BenchPerfStop(int* PerfFD, s64* Count);
+void					BenchFilter(BenchRun_t* Run, const fFMADRingPacket_t* const* Pkt, u32 Cnt);
+
+// C++ API runs, bench_cpp.cpp. the depth is a template parameter so only a few are built
+bool					BenchCppDepth(u64 Depth);
+void*					BenchProducerCpp(void* Arg);
+void*					BenchConsumerCpp(void* Arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif